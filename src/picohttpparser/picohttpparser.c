@@ -27,7 +27,10 @@
 #include <assert.h>
 #include <stddef.h>
 #include <string.h>
-#ifdef __SSE4_2__
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__)) && defined(__ELF__)
+#define PHR_DISPATCH 1
+#include <x86intrin.h>
+#elif defined(__SSE4_2__)
 #ifdef _MSC_VER
 #include <nmmintrin.h>
 #else
@@ -101,10 +104,23 @@ static const char *token_char_map = "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
                                     "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0";
 
-static const char *findchar_fast(const char *buf, const char *buf_end, const char *ranges, size_t ranges_size, int *found)
+static const char *findchar_scalar(const char *buf, const char *buf_end, const char *ranges, size_t ranges_size, int *found)
+{
+    *found = 0;
+    /* suppress unused parameter warning */
+    (void)buf_end;
+    (void)ranges;
+    (void)ranges_size;
+    return buf;
+}
+
+#if PHR_DISPATCH || __SSE4_2__
+#if PHR_DISPATCH
+__attribute__((target("sse4.2")))
+#endif
+static const char *findchar_sse42(const char *buf, const char *buf_end, const char *ranges, size_t ranges_size, int *found)
 {
     *found = 0;
-#if __SSE4_2__
     if (likely(buf_end - buf >= 16)) {
         __m128i ranges16 = _mm_loadu_si128((const __m128i *)ranges);
 
@@ -121,32 +137,94 @@ static const char *findchar_fast(const char *buf, const char *buf_end, const cha
             left -= 16;
         } while (likely(left != 0));
     }
-#else
-    /* suppress unused parameter warning */
-    (void)buf_end;
-    (void)ranges;
-    (void)ranges_size;
-#endif
     return buf;
 }
+#endif
+
+#if PHR_DISPATCH
+/* same contract as findchar_sse42, 32 bytes at a time; a byte is in a range when its offset from the low end is
+ * at most the width of the range */
+__attribute__((target("avx2,sse4.2")))
+static const char *findchar_avx2(const char *buf, const char *buf_end, const char *ranges, size_t ranges_size, int *found)
+{
+    *found = 0;
+    /* like pcmpestri, take at most 8 ranges; anything longer is left to the caller's byte loop */
+    if (unlikely(ranges_size > 16))
+        return findchar_scalar(buf, buf_end, ranges, ranges_size, found);
+    /* short tokens and lines end in the first 16 bytes, one pcmpestri settles those without the setup below */
+    if (likely(buf_end - buf >= 16)) {
+        int r = _mm_cmpestri(_mm_loadu_si128((const __m128i *)ranges), ranges_size, _mm_loadu_si128((const __m128i *)buf), 16,
+                             _SIDD_LEAST_SIGNIFICANT | _SIDD_CMP_RANGES | _SIDD_UBYTE_OPS);
+        if (r != 16) {
+            *found = 1;
+            return buf + r;
+        }
+        buf += 16;
+    }
+    if (likely(buf_end - buf >= 32)) {
+        __m256i lo[8], width[8];
+        size_t i, n = ranges_size / 2;
+
+        for (i = 0; i < n; ++i) {
+            lo[i] = _mm256_set1_epi8(ranges[i * 2]);
+            width[i] = _mm256_set1_epi8((char)(ranges[i * 2 + 1] - ranges[i * 2]));
+        }
+        size_t left = (buf_end - buf) & ~31;
+        do {
+            __m256i b32 = _mm256_loadu_si256((const __m256i *)buf);
+            __m256i match = _mm256_setzero_si256();
+            for (i = 0; i < n; ++i) {
+                __m256i offset = _mm256_sub_epi8(b32, lo[i]);
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi8(_mm256_min_epu8(offset, width[i]), offset));
+            }
+            unsigned mask = (unsigned)_mm256_movemask_epi8(match);
+            if (unlikely(mask != 0)) {
+                *found = 1;
+                return buf + __builtin_ctz(mask);
+            }
+            buf += 32;
+            left -= 32;
+        } while (likely(left != 0));
+    }
+    return findchar_sse42(buf, buf_end, ranges, ranges_size, found);
+}
+
+typedef const char *(*findchar_func)(const char *, const char *, const char *, size_t, int *);
+
+static findchar_func findchar_resolve(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return findchar_avx2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return findchar_sse42;
+    return findchar_scalar;
+}
+
+static const char *findchar_fast(const char *buf, const char *buf_end, const char *ranges, size_t ranges_size, int *found)
+    __attribute__((ifunc("findchar_resolve")));
+#elif __SSE4_2__
+#define findchar_fast findchar_sse42
+#else
+#define findchar_fast findchar_scalar
+#endif
 
 static const char *get_token_to_eol(const char *buf, const char *buf_end, const char **token, size_t *token_len, int *ret)
 {
     const char *token_start = buf;
-
-#ifdef __SSE4_2__
-    static const char ranges1[] = "\0\010"
-                                  /* allow HT */
-                                  "\012\037"
-                                  /* allow SP and up to but not including DEL */
-                                  "\177\177"
+    static const char ALIGNED(16) ranges1[] = "\0\010"
+                                              /* allow HT */
+                                              "\012\037"
+                                              /* allow SP and up to but not including DEL */
+                                              "\177\177"
         /* allow chars w. MSB set */
         ;
     int found;
+
+    /* vector scan when available, the scalar loops below then only handle the tail */
     buf = findchar_fast(buf, buf_end, ranges1, sizeof(ranges1) - 1, &found);
     if (found)
         goto FOUND_CTL;
-#else
     /* find non-printable char within the next 8 bytes, this is the hottest code; manually inlined */
     while (likely(buf_end - buf >= 8)) {
 #define DOIT()                                                                                                                     \
@@ -171,7 +249,6 @@ static const char *get_token_to_eol(const char *buf, const char *buf_end, const
         }
         ++buf;
     }
-#endif
     for (;; ++buf) {
         CHECK_EOF();
         if (unlikely(!IS_PRINTABLE_ASCII(*buf))) {
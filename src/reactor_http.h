@@ -12,8 +12,12 @@ extern "C" {
 
 #include "reactor_http/reactor_http.h"
 #include "reactor_http/reactor_http_parser.h"
+#include "reactor_http/reactor_http_resolver.h"
 #include "reactor_http/reactor_http_client.h"
+#include "reactor_http/reactor_http_client_pool.h"
 #include "reactor_http/reactor_http_server.h"
+#include "reactor_http/reactor_http_server_static.h"
+#include "reactor_http/reactor_http_server_workers.h"
 
 #ifdef __cplusplus
 }
@@ -4,8 +4,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <regex.h>
+#include <ctype.h>
 #include <netdb.h>
+#include <time.h>
 
 #include <dynamic.h>
 #include <clo.h>
@@ -14,6 +15,14 @@
 
 #include "reactor_http.h"
 
+/* digit value plus one, zero marks a non hex character */
+static const unsigned char reactor_http_hex_table[256] =
+  {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+  };
+
 static const char *reactor_http_response_message[] =
   {
     [100] = "Continue",
@@ -58,36 +67,199 @@ static const char *reactor_http_response_message[] =
     [505] = "HTTP Version Not Supported"
   };
 
-char *reactor_http_split_match(regmatch_t *, char *, char *);
+typedef struct reactor_http_field_name reactor_http_field_name;
+struct reactor_http_field_name
+{
+  const char            *name;
+  size_t                 size;
+  int                    id;
+};
 
-int reactor_http_split_url(char *url, char **host, char **service, char **path)
+/* perfect hash of the known field names, see reactor_http_field_id() */
+static const reactor_http_field_name reactor_http_field_names[64] =
+  {
+    [0] = {"x-forwarded-for", 15, REACTOR_HTTP_FIELD_X_FORWARDED_FOR},
+    [4] = {"accept", 6, REACTOR_HTTP_FIELD_ACCEPT},
+    [5] = {"set-cookie", 10, REACTOR_HTTP_FIELD_SET_COOKIE},
+    [6] = {"origin", 6, REACTOR_HTTP_FIELD_ORIGIN},
+    [7] = {"accept-language", 15, REACTOR_HTTP_FIELD_ACCEPT_LANGUAGE},
+    [9] = {"accept-encoding", 15, REACTOR_HTTP_FIELD_ACCEPT_ENCODING},
+    [10] = {"server", 6, REACTOR_HTTP_FIELD_SERVER},
+    [12] = {"host", 4, REACTOR_HTTP_FIELD_HOST},
+    [13] = {"date", 4, REACTOR_HTTP_FIELD_DATE},
+    [18] = {"cache-control", 13, REACTOR_HTTP_FIELD_CACHE_CONTROL},
+    [19] = {"etag", 4, REACTOR_HTTP_FIELD_ETAG},
+    [22] = {"if-none-match", 13, REACTOR_HTTP_FIELD_IF_NONE_MATCH},
+    [23] = {"upgrade", 7, REACTOR_HTTP_FIELD_UPGRADE},
+    [27] = {"if-modified-since", 17, REACTOR_HTTP_FIELD_IF_MODIFIED_SINCE},
+    [28] = {"user-agent", 10, REACTOR_HTTP_FIELD_USER_AGENT},
+    [29] = {"cookie", 6, REACTOR_HTTP_FIELD_COOKIE},
+    [30] = {"location", 8, REACTOR_HTTP_FIELD_LOCATION},
+    [36] = {"expect", 6, REACTOR_HTTP_FIELD_EXPECT},
+    [37] = {"keep-alive", 10, REACTOR_HTTP_FIELD_KEEP_ALIVE},
+    [39] = {"range", 5, REACTOR_HTTP_FIELD_RANGE},
+    [41] = {"content-type", 12, REACTOR_HTTP_FIELD_CONTENT_TYPE},
+    [44] = {"authorization", 13, REACTOR_HTTP_FIELD_AUTHORIZATION},
+    [46] = {"connection", 10, REACTOR_HTTP_FIELD_CONNECTION},
+    [48] = {"content-length", 14, REACTOR_HTTP_FIELD_CONTENT_LENGTH},
+    [51] = {"content-encoding", 16, REACTOR_HTTP_FIELD_CONTENT_ENCODING},
+    [56] = {"referer", 7, REACTOR_HTTP_FIELD_REFERER},
+    [57] = {"transfer-encoding", 17, REACTOR_HTTP_FIELD_TRANSFER_ENCODING},
+    [62] = {"last-modified", 13, REACTOR_HTTP_FIELD_LAST_MODIFIED}
+  };
+
+int reactor_http_split_url(char *data, char **host, char **service, char **path)
 {
-  regmatch_t match[6];
-  regex_t reg;
+  reactor_http_url url;
+  reactor_http_range target;
+  size_t end;
   int e;
 
-  e = regcomp(&reg, "^http://([^/?#:]*)(:([^/]+))?(/(.*))?", REG_EXTENDED);
-  if (e == -1)
+  e = reactor_http_url_parse(&url, data, strlen(data));
+  if (e == -1 || url.scheme.size != 4 || strncasecmp(data, "http", 4) != 0)
     return -1;
 
-  e = regexec(&reg, url, 6, match, 0);
-  regfree(&reg);
-  if (e == REG_NOMATCH)
+  /* the authority is moved one byte back over the scheme separator, so terminating the host and port
+   * does not overwrite the '/' or '?' that starts the request target */
+  end = url.port.size ? url.port.offset + url.port.size : url.host.offset + url.host.size;
+  if (end > url.host.offset)
+    {
+      memmove(data + url.host.offset - 1, data + url.host.offset, end - url.host.offset);
+      url.host.offset --;
+      url.port.offset --;
+    }
+  *host = url.host.size ? data + url.host.offset : "localhost";
+  *service = url.port.size ? data + url.port.offset : "80";
+  target = reactor_http_url_target(&url);
+  *path = data + target.offset;
+  data[target.offset + target.size] = '\0';
+  if (url.port.size)
+    data[url.port.offset + url.port.size] = '\0';
+  if (url.host.size)
+    data[url.host.offset + url.host.size] = '\0';
+  return 0;
+}
+
+int reactor_http_url_parse(reactor_http_url *url, char *data, size_t size)
+{
+  size_t i, begin, end;
+  char *p;
+
+  *url = (reactor_http_url) {0};
+  if (size > UINT32_MAX)
     return -1;
+  for (i = 0; i < size; i ++)
+    if ((unsigned char) data[i] <= ' ' || data[i] == 0x7f)
+      return -1;
+
+  for (i = 0; i < size && (isalnum((unsigned char) data[i]) || data[i] == '+' || data[i] == '-' || data[i] == '.'); i ++);
+  if (i && isalpha((unsigned char) data[0]) && size - i >= 3 && memcmp(data + i, "://", 3) == 0)
+    {
+      url->scheme = (reactor_http_range) {.offset = 0, .size = i};
+      for (begin = i + 3, end = begin; end < size && data[end] != '/' && data[end] != '?' && data[end] != '#'; end ++);
+      p = memrchr(data + begin, '@', end - begin);
+      if (p)
+        begin = p - data + 1;
 
-  *host = reactor_http_split_match(&match[1], url, "localhost");
-  *service = reactor_http_split_match(&match[3], url, "80");
-  *path = reactor_http_split_match(&match[5], url, "");
+      if (begin < end && data[begin] == '[')
+        {
+          p = memchr(data + begin, ']', end - begin);
+          if (!p)
+            return -1;
+          url->host = (reactor_http_range) {.offset = begin + 1, .size = p - data - begin - 1};
+          i = p - data + 1;
+        }
+      else
+        {
+          for (i = begin; i < end && data[i] != ':'; i ++);
+          url->host = (reactor_http_range) {.offset = begin, .size = i - begin};
+        }
+
+      if (i < end)
+        {
+          if (data[i] != ':')
+            return -1;
+          url->port = (reactor_http_range) {.offset = i + 1, .size = end - i - 1};
+          for (i ++; i < end; i ++)
+            if (!isdigit((unsigned char) data[i]))
+              return -1;
+        }
+      i = end;
+    }
+  else
+    i = 0;
+
+  for (begin = i; i < size && data[i] != '?' && data[i] != '#'; i ++);
+  url->path = (reactor_http_range) {.offset = begin, .size = i - begin};
+  if (i < size && data[i] == '?')
+    {
+      for (begin = ++ i; i < size && data[i] != '#'; i ++);
+      url->query = (reactor_http_range) {.offset = begin, .size = i - begin};
+    }
+  if (i < size && data[i] == '#')
+    url->fragment = (reactor_http_range) {.offset = i + 1, .size = size - i - 1};
   return 0;
 }
 
-char *reactor_http_split_match(regmatch_t *match, char *string, char *def)
+reactor_http_range reactor_http_url_target(reactor_http_url *url)
+{
+  size_t begin, end;
+
+  /* the path of an absolute url without its leading slash followed by the query, or the query with its '?' when the path is empty */
+  end = url->query.size ? url->query.offset + url->query.size : url->path.offset + url->path.size;
+  if (url->path.size)
+    begin = url->path.offset + 1;
+  else
+    begin = url->query.size ? url->query.offset - 1 : end;
+  return (reactor_http_range) {.offset = begin, .size = end - begin};
+}
+
+ssize_t reactor_http_url_decode(char *to, char *from, size_t size)
 {
-  if (match->rm_so == -1 || match->rm_eo == -1)
-    return def;
+  size_t i, n;
+  int high, low;
+
+  for (i = 0, n = 0; i < size; i ++, n ++)
+    {
+      if (from[i] != '%')
+        {
+          to[n] = from[i];
+          continue;
+        }
+      if (size - i < 3)
+        return -1;
+      high = reactor_http_hex(from[i + 1]);
+      low = reactor_http_hex(from[i + 2]);
+      if (high == -1 || low == -1)
+        return -1;
+      to[n] = (high << 4) | low;
+      i += 2;
+    }
 
-  string[match->rm_eo] = '\0';
-  return &string[match->rm_so];
+  return n;
+}
+
+int reactor_http_hex(int c)
+{
+  return (int) reactor_http_hex_table[(unsigned char) c] - 1;
+}
+
+int reactor_http_token(char *value, size_t size, char *token)
+{
+  size_t i, n, trimmed, token_size;
+
+  /* comma separated list as in the Connection field, matched case insensitively */
+  token_size = strlen(token);
+  for (i = 0; i < size; i += n + 1)
+    {
+      while (i < size && (value[i] == ' ' || value[i] == '\t'))
+        i ++;
+      for (n = 0; i + n < size && value[i + n] != ','; n ++);
+      for (trimmed = n; trimmed && (value[i + trimmed - 1] == ' ' || value[i + trimmed - 1] == '\t'); trimmed --);
+      if (trimmed == token_size && strncasecmp(value + i, token, token_size) == 0)
+        return 1;
+    }
+  return 0;
 }
 
 int reactor_http_field_add_range(vector *fields, char *key, size_t key_len, char *value, size_t value_len)
@@ -114,6 +286,29 @@ char *reactor_http_field_lookup(vector *fields, char *key)
   return NULL;
 }
 
+int reactor_http_field_id(const char *name, size_t size)
+{
+  const reactor_http_field_name *known;
+  unsigned h;
+
+  if (size < 2)
+    return REACTOR_HTTP_FIELD_UNKNOWN;
+
+  h = (size * 2 + (name[0] | 0x20) * 20 + ((name[1] | 0x20) << 4) + (name[size - 1] | 0x20)) & 63;
+  known = &reactor_http_field_names[h];
+  if (known->size == size && strncasecmp(known->name, name, size) == 0)
+    return known->id;
+  return REACTOR_HTTP_FIELD_UNKNOWN;
+}
+
+char *reactor_http_field_lookup_id(vector *fields, uint8_t *known, int id)
+{
+  if (!known[id])
+    return NULL;
+
+  return ((reactor_http_field *) vector_at(fields, known[id] - 1))->value;
+}
+
 void reactor_http_field_offset(vector *fields, off_t offset)
 {
   size_t i;
@@ -127,15 +322,77 @@ void reactor_http_field_offset(vector *fields, off_t offset)
     }
 }
 
+int reactor_http_range_add(vector *ranges, char *base, char *key, size_t key_len, char *value, size_t value_len)
+{
+  reactor_http_field_range range;
+
+  range = (reactor_http_field_range) {
+    .key = {.offset = key - base, .size = key_len},
+    .value = {.offset = value - base, .size = value_len}
+  };
+  return vector_push_back(ranges, &range);
+}
+
+char *reactor_http_range_data(char *base, reactor_http_range *range)
+{
+  return base + range->offset;
+}
+
+reactor_http_field_range *reactor_http_range_lookup(vector *ranges, char *base, char *key)
+{
+  size_t i, size;
+  reactor_http_field_range *range;
+
+  size = strlen(key);
+  for (i = 0; i < vector_size(ranges); i ++)
+    {
+      range = vector_at(ranges, i);
+      if (range->key.size == size && strncasecmp(base + range->key.offset, key, size) == 0)
+        return range;
+    }
+  return NULL;
+}
+
+reactor_http_field_range *reactor_http_range_lookup_id(vector *ranges, uint8_t *known, int id)
+{
+  if (!known[id])
+    return NULL;
+
+  return vector_at(ranges, known[id] - 1);
+}
+
+char *reactor_http_field_value_id(vector *fields, vector *ranges, uint8_t *known, char *base, int id, size_t *size)
+{
+  reactor_http_field_range *range;
+  char *value;
+
+  /* the parser fills either the ranges or the pointer fields, depending on REACTOR_HTTP_PARSER_FLAGS_RANGES */
+  if (vector_size(ranges))
+    {
+      range = reactor_http_range_lookup_id(ranges, known, id);
+      if (!range)
+        return NULL;
+      *size = range->value.size;
+      return reactor_http_range_data(base, &range->value);
+    }
+
+  value = reactor_http_field_lookup_id(fields, known, id);
+  if (value)
+    *size = strlen(value);
+  return value;
+}
+
 void reactor_http_request_init(reactor_http_request *request)
 {
-  *request = (reactor_http_request) {0};
+  *request = (reactor_http_request) {.content_fd = -1};
   vector_init(&request->fields, sizeof(reactor_http_field));
+  vector_init(&request->ranges, sizeof(reactor_http_field_range));
 }
 
 void reactor_http_request_clear(reactor_http_request *request)
 {
   vector_clear(&request->fields);
+  vector_clear(&request->ranges);
 }
 
 void reactor_http_request_create(reactor_http_request *request, char *host, char *service, char *method, char *path, char *content, size_t content_size)
@@ -147,9 +404,11 @@ void reactor_http_request_create(reactor_http_request *request, char *host, char
       .service = service,
       .path = path,
       .content = content,
-      .content_size = content_size
+      .content_size = content_size,
+      .content_fd = -1
     };
     vector_init(&request->fields, sizeof(reactor_http_field));
+    vector_init(&request->ranges, sizeof(reactor_http_field_range));
 }
 
 void reactor_http_request_add_header(reactor_http_request *request, char *key, char *value)
@@ -183,10 +442,146 @@ void reactor_http_request_send(reactor_http_request *request, reactor_stream *st
   reactor_stream_puts(stream, "\r\n");
 }
 
+char *reactor_http_request_method(reactor_http_request *request, size_t *size)
+{
+  *size = request->method_range.size;
+  return reactor_http_range_data(request->base, &request->method_range);
+}
+
+char *reactor_http_request_path(reactor_http_request *request, size_t *size)
+{
+  *size = request->path_range.size;
+  return reactor_http_range_data(request->base, &request->path_range);
+}
+
+char *reactor_http_request_field(reactor_http_request *request, char *key, size_t *size)
+{
+  reactor_http_field_range *range;
+  char *value;
+
+  if (!vector_size(&request->ranges))
+    {
+      value = reactor_http_field_lookup(&request->fields, key);
+      if (value)
+        *size = strlen(value);
+      return value;
+    }
+
+  range = reactor_http_range_lookup(&request->ranges, request->base, key);
+  if (!range)
+    return NULL;
+
+  *size = range->value.size;
+  return reactor_http_range_data(request->base, &range->value);
+}
+
+char *reactor_http_request_field_id(reactor_http_request *request, int id, size_t *size)
+{
+  return reactor_http_field_value_id(&request->fields, &request->ranges, request->known, request->base, id, size);
+}
+
+void reactor_http_date(char *date, time_t t)
+{
+  static const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  struct tm tm;
+
+  (void) gmtime_r(&t, &tm);
+  (void) strftime(date, REACTOR_HTTP_DATE_SIZE, "---, %d --- %Y %H:%M:%S GMT", &tm);
+  memcpy(date, days[tm.tm_wday], 3);
+  memcpy(date + 8, months[tm.tm_mon], 3);
+}
+
+char *reactor_http_status_message(unsigned status)
+{
+  if (status < sizeof reactor_http_response_message / sizeof reactor_http_response_message[0] &&
+      reactor_http_response_message[status])
+    return (char *) reactor_http_response_message[status];
+  return "Undefined";
+}
+
+void reactor_http_builder_init(reactor_http_builder *builder, buffer *overflow)
+{
+  builder->data = builder->stack;
+  builder->size = 0;
+  builder->overflow = overflow;
+  builder->error = 0;
+}
+
+void reactor_http_builder_write(reactor_http_builder *builder, char *data, size_t size)
+{
+  int e;
+
+  if (builder->error)
+    return;
+
+  if (builder->data == builder->stack)
+    {
+      if (builder->size + size <= sizeof builder->stack)
+        {
+          memcpy(builder->stack + builder->size, data, size);
+          builder->size += size;
+          return;
+        }
+
+      /* spill to the overflow buffer, which keeps its capacity between uses */
+      if (!builder->overflow)
+        {
+          builder->error = 1;
+          return;
+        }
+      buffer_erase(builder->overflow, 0, buffer_size(builder->overflow));
+      e = buffer_insert(builder->overflow, 0, builder->stack, builder->size);
+      if (e == -1)
+        {
+          builder->error = 1;
+          return;
+        }
+    }
+
+  e = buffer_insert(builder->overflow, buffer_size(builder->overflow), data, size);
+  if (e == -1)
+    {
+      builder->error = 1;
+      return;
+    }
+  builder->data = buffer_data(builder->overflow);
+  builder->size += size;
+}
+
+void reactor_http_builder_puts(reactor_http_builder *builder, char *string)
+{
+  reactor_http_builder_write(builder, string, strlen(string));
+}
+
+void reactor_http_builder_putu(reactor_http_builder *builder, size_t value)
+{
+  char digits[20], *p;
+
+  p = digits + sizeof digits;
+  do
+    {
+      p --;
+      *p = '0' + value % 10;
+      value /= 10;
+    }
+  while (value);
+  reactor_http_builder_write(builder, p, digits + sizeof digits - p);
+}
+
+void reactor_http_builder_field(reactor_http_builder *builder, char *key, char *value)
+{
+  reactor_http_builder_puts(builder, key);
+  reactor_http_builder_write(builder, ": ", 2);
+  reactor_http_builder_puts(builder, value);
+  reactor_http_builder_write(builder, "\r\n", 2);
+}
+
 void reactor_http_response_init(reactor_http_response *response)
 {
-  *response = (reactor_http_response) {0};
+  *response = (reactor_http_response) {.content_fd = -1};
   vector_init(&response->fields, sizeof(reactor_http_field));
+  vector_init(&response->ranges, sizeof(reactor_http_field_range));
 }
 
 void reactor_http_response_create(reactor_http_response *response, unsigned status, char *content, size_t content_size)
@@ -196,11 +591,7 @@ void reactor_http_response_create(reactor_http_response *response, unsigned stat
   response->minor_version = 1;
   response->content = content;
   response->content_size = content_size;
-  if (status < sizeof reactor_http_response_message / sizeof reactor_http_response_message[0] &&
-      reactor_http_response_message[status])
-    response->message = (char *) reactor_http_response_message[status];
-  else
-    response->message = "Undefined";
+  response->message = reactor_http_status_message(status);
 }
 
 void reactor_http_response_add_header(reactor_http_response *response, char *key, char *value)
@@ -240,4 +631,37 @@ void reactor_http_response_send(reactor_http_response *response, reactor_stream
 void reactor_http_response_clear(reactor_http_response *response)
 {
   vector_clear(&response->fields);
+  vector_clear(&response->ranges);
+}
+
+char *reactor_http_response_reason(reactor_http_response *response, size_t *size)
+{
+  *size = response->message_range.size;
+  return reactor_http_range_data(response->base, &response->message_range);
+}
+
+char *reactor_http_response_field(reactor_http_response *response, char *key, size_t *size)
+{
+  reactor_http_field_range *range;
+  char *value;
+
+  if (!vector_size(&response->ranges))
+    {
+      value = reactor_http_field_lookup(&response->fields, key);
+      if (value)
+        *size = strlen(value);
+      return value;
+    }
+
+  range = reactor_http_range_lookup(&response->ranges, response->base, key);
+  if (!range)
+    return NULL;
+
+  *size = range->value.size;
+  return reactor_http_range_data(response->base, &range->value);
+}
+
+char *reactor_http_response_field_id(reactor_http_response *response, int id, size_t *size)
+{
+  return reactor_http_field_value_id(&response->fields, &response->ranges, response->known, response->base, id, size);
 }
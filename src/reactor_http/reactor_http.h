@@ -3,6 +3,46 @@
 
 #define REACTOR_HTTP_HEADER_MAX_FIELDS 32
 
+enum reactor_http_field_id
+{
+  REACTOR_HTTP_FIELD_UNKNOWN,
+  REACTOR_HTTP_FIELD_ACCEPT,
+  REACTOR_HTTP_FIELD_ACCEPT_ENCODING,
+  REACTOR_HTTP_FIELD_ACCEPT_LANGUAGE,
+  REACTOR_HTTP_FIELD_AUTHORIZATION,
+  REACTOR_HTTP_FIELD_CACHE_CONTROL,
+  REACTOR_HTTP_FIELD_CONNECTION,
+  REACTOR_HTTP_FIELD_CONTENT_ENCODING,
+  REACTOR_HTTP_FIELD_CONTENT_LENGTH,
+  REACTOR_HTTP_FIELD_CONTENT_TYPE,
+  REACTOR_HTTP_FIELD_COOKIE,
+  REACTOR_HTTP_FIELD_DATE,
+  REACTOR_HTTP_FIELD_ETAG,
+  REACTOR_HTTP_FIELD_EXPECT,
+  REACTOR_HTTP_FIELD_HOST,
+  REACTOR_HTTP_FIELD_IF_MODIFIED_SINCE,
+  REACTOR_HTTP_FIELD_IF_NONE_MATCH,
+  REACTOR_HTTP_FIELD_KEEP_ALIVE,
+  REACTOR_HTTP_FIELD_LAST_MODIFIED,
+  REACTOR_HTTP_FIELD_LOCATION,
+  REACTOR_HTTP_FIELD_ORIGIN,
+  REACTOR_HTTP_FIELD_RANGE,
+  REACTOR_HTTP_FIELD_REFERER,
+  REACTOR_HTTP_FIELD_SERVER,
+  REACTOR_HTTP_FIELD_SET_COOKIE,
+  REACTOR_HTTP_FIELD_TRANSFER_ENCODING,
+  REACTOR_HTTP_FIELD_UPGRADE,
+  REACTOR_HTTP_FIELD_USER_AGENT,
+  REACTOR_HTTP_FIELD_X_FORWARDED_FOR,
+  REACTOR_HTTP_FIELD_MAX
+};
+
+#define REACTOR_HTTP_DATE_SIZE 32
+
+#ifndef REACTOR_HTTP_BUILDER_SIZE
+#define REACTOR_HTTP_BUILDER_SIZE 1024
+#endif /* REACTOR_HTTP_BUILDER_SIZE */
+
 typedef struct reactor_http_field reactor_http_field;
 struct reactor_http_field
 {
@@ -10,6 +50,31 @@ struct reactor_http_field
   char                  *value;
 };
 
+typedef struct reactor_http_range reactor_http_range;
+struct reactor_http_range
+{
+  uint32_t              offset;
+  uint32_t              size;
+};
+
+typedef struct reactor_http_field_range reactor_http_field_range;
+struct reactor_http_field_range
+{
+  reactor_http_range    key;
+  reactor_http_range    value;
+};
+
+typedef struct reactor_http_url reactor_http_url;
+struct reactor_http_url
+{
+  reactor_http_range    scheme;
+  reactor_http_range    host;
+  reactor_http_range    port;
+  reactor_http_range    path;
+  reactor_http_range    query;
+  reactor_http_range    fragment;
+};
+
 typedef struct reactor_http_request reactor_http_request;
 struct reactor_http_request
 {
@@ -21,7 +86,12 @@ struct reactor_http_request
   char                 *service;
   char                 *content;
   size_t                content_size;
+  int                   content_fd;
   vector                fields;
+  reactor_http_range    method_range;
+  reactor_http_range    path_range;
+  vector                ranges;
+  uint8_t               known[REACTOR_HTTP_FIELD_MAX];
 };
 
 typedef struct reactor_http_response reactor_http_response;
@@ -32,25 +102,69 @@ struct reactor_http_response
   int                    minor_version;
   char                  *content;
   size_t                 content_size;
+  int                    content_fd;
   vector                 fields;
+  char                  *base;
+  reactor_http_range     message_range;
+  vector                 ranges;
+  uint8_t                known[REACTOR_HTTP_FIELD_MAX];
+};
+
+typedef struct reactor_http_builder reactor_http_builder;
+struct reactor_http_builder
+{
+  char                  *data;
+  size_t                 size;
+  buffer                *overflow;
+  int                    error;
+  char                   stack[REACTOR_HTTP_BUILDER_SIZE];
 };
 
 int   reactor_http_split_url(char *, char **, char **, char **);
+int   reactor_http_url_parse(reactor_http_url *, char *, size_t);
+reactor_http_range reactor_http_url_target(reactor_http_url *);
+ssize_t reactor_http_url_decode(char *, char *, size_t);
+int   reactor_http_hex(int);
+int   reactor_http_token(char *, size_t, char *);
 
 int   reactor_http_field_add_range(vector *, char *, size_t, char *, size_t);
 char *reactor_http_field_lookup(vector *, char *);
+int   reactor_http_field_id(const char *, size_t);
+char *reactor_http_field_lookup_id(vector *, uint8_t *, int);
 void  reactor_http_field_offset(vector *, off_t);
 
+int   reactor_http_range_add(vector *, char *, char *, size_t, char *, size_t);
+char *reactor_http_range_data(char *, reactor_http_range *);
+reactor_http_field_range *reactor_http_range_lookup(vector *, char *, char *);
+reactor_http_field_range *reactor_http_range_lookup_id(vector *, uint8_t *, int);
+char *reactor_http_field_value_id(vector *, vector *, uint8_t *, char *, int, size_t *);
+
 void  reactor_http_request_init(reactor_http_request *);
 void  reactor_http_request_clear(reactor_http_request *);
 void  reactor_http_request_create(reactor_http_request *, char *, char *, char *, char *, char *, size_t);
 void  reactor_http_request_add_header(reactor_http_request *, char *, char *);
 void  reactor_http_request_send(reactor_http_request *, reactor_stream *);
+char *reactor_http_request_method(reactor_http_request *, size_t *);
+char *reactor_http_request_path(reactor_http_request *, size_t *);
+char *reactor_http_request_field(reactor_http_request *, char *, size_t *);
+char *reactor_http_request_field_id(reactor_http_request *, int, size_t *);
+
+void  reactor_http_date(char *, time_t);
+char *reactor_http_status_message(unsigned);
+
+void  reactor_http_builder_init(reactor_http_builder *, buffer *);
+void  reactor_http_builder_write(reactor_http_builder *, char *, size_t);
+void  reactor_http_builder_puts(reactor_http_builder *, char *);
+void  reactor_http_builder_putu(reactor_http_builder *, size_t);
+void  reactor_http_builder_field(reactor_http_builder *, char *, char *);
 
 void  reactor_http_response_init(reactor_http_response *);
 void  reactor_http_response_create(reactor_http_response *, unsigned, char *, size_t);
 void  reactor_http_response_add_header(reactor_http_response *, char *, char *);
 void  reactor_http_response_send(reactor_http_response *, reactor_stream *);
 void  reactor_http_response_clear(reactor_http_response *);
+char *reactor_http_response_reason(reactor_http_response *, size_t *);
+char *reactor_http_response_field(reactor_http_response *, char *, size_t *);
+char *reactor_http_response_field_id(reactor_http_response *, int, size_t *);
 
 #endif /* REACTOR_HTTP_H_INCLUDED */
@@ -4,7 +4,9 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <sys/socket.h>
 
 #include <dynamic.h>
@@ -15,7 +17,9 @@
 #include "picohttpparser.h"
 #include "reactor_http.h"
 #include "reactor_http_parser.h"
+#include "reactor_http_resolver.h"
 #include "reactor_http_client.h"
+#include "reactor_http_client_pool.h"
 
 void reactor_http_client_init(reactor_http_client *client, reactor_user_call *call, void *state)
 {
@@ -26,29 +30,94 @@ void reactor_http_client_init(reactor_http_client *client, reactor_user_call *ca
   reactor_stream_init(&client->stream, reactor_http_client_stream_event, client);
   reactor_tcp_client_init(&client->tcp_client, reactor_http_client_tcp_client_event, client);
   reactor_http_parser_init(&client->parser, reactor_http_client_parser_event, client);
+  vector_init(&client->exchanges, sizeof(reactor_http_client_exchange));
+  buffer_init(&client->uri);
 }
 
 int reactor_http_client_open(reactor_http_client *client, char *method, char *uri, char *content, size_t content_size, int flags)
 {
   int e;
-  char *host, *service, *path;
+  char *path;
 
   if (client->state != REACTOR_HTTP_CLIENT_CLOSED)
     return -1;
 
-  client->uri = strdup(uri);
-  if (!client->uri)
+  e = reactor_http_client_target(client, uri, &path);
+  if (e == -1)
     return -1;
 
-  e = reactor_http_split_url(client->uri, &host, &service, &path);
-  if (e == -1)
+  reactor_http_request_create(&client->request, client->host, client->service, method, path, content, content_size);
+  reactor_http_request_add_header(&client->request, "Connection", client->pool ? "keep-alive" : "close");
+  client->flags = flags;
+  reactor_http_parser_open_response(&client->parser, &client->response, reactor_http_client_flags(method, flags));
+  return reactor_http_client_connect(client);
+}
+
+int reactor_http_client_target(reactor_http_client *client, char *uri, char **path)
+{
+  reactor_http_url *url;
+  reactor_http_range target;
+  char *parts[4], *data;
+  size_t sizes[4], offsets[4], i;
+  int e;
+
+  url = &client->url;
+  e = reactor_http_url_parse(url, uri, strlen(uri));
+  if (e == -1 || url->scheme.size != 4 || strncasecmp(uri, "http", 4) != 0)
     return -1;
 
-  reactor_http_request_create(&client->request, host, service, method, path, content, content_size);
-  reactor_http_request_add_header(&client->request, "Connection", "close");
-  reactor_http_parser_open_response(&client->parser, &client->response, flags);
+  /* the uri is kept whole and followed by the host, service and request target taken from its ranges,
+   * in storage that keeps its capacity for the next request on the connection */
+  target = reactor_http_url_target(url);
+  parts[0] = uri;
+  sizes[0] = strlen(uri);
+  parts[1] = url->host.size ? uri + url->host.offset : "localhost";
+  sizes[1] = url->host.size ? url->host.size : strlen("localhost");
+  parts[2] = url->port.size ? uri + url->port.offset : "80";
+  sizes[2] = url->port.size ? url->port.size : strlen("80");
+  parts[3] = uri + target.offset;
+  sizes[3] = target.size;
+
+  buffer_erase(&client->uri, 0, buffer_size(&client->uri));
+  for (i = 0; i < 4; i ++)
+    {
+      offsets[i] = buffer_size(&client->uri);
+      if (buffer_insert(&client->uri, offsets[i], parts[i], sizes[i]) == -1 ||
+          buffer_insert(&client->uri, offsets[i] + sizes[i], "", 1) == -1)
+        return -1;
+    }
+
+  data = buffer_data(&client->uri);
+  client->host = data + offsets[1];
+  client->service = data + offsets[2];
+  *path = data + offsets[3];
+  return 0;
+}
+
+void reactor_http_client_resolver(reactor_http_client *client, reactor_http_resolver *resolver)
+{
+  client->resolver = resolver;
+}
+
+int reactor_http_client_connect(reactor_http_client *client)
+{
+  reactor_http_resolver_result result;
+  int e;
 
-  e = reactor_tcp_client_open(&client->tcp_client, &client->stream, host, service);
+  if (client->resolver)
+    {
+      e = reactor_http_resolver_lookup(client->resolver, client->host, &result, reactor_http_client_resolver_event, client);
+      if (e == -1 || (e == 1 && result.error))
+        return -1;
+      if (e == 0)
+        {
+          client->state = REACTOR_HTTP_CLIENT_RESOLVING;
+          return 0;
+        }
+      e = reactor_tcp_client_open(&client->tcp_client, &client->stream, result.address, client->service);
+    }
+  else
+    e = reactor_tcp_client_open(&client->tcp_client, &client->stream, client->host, client->service);
   if (e == -1)
     return -1;
 
@@ -56,11 +125,43 @@ int reactor_http_client_open(reactor_http_client *client, char *method, char *ur
   return 0;
 }
 
+int reactor_http_client_send(reactor_http_client *client, char *method, char *uri, char *content, size_t content_size, int flags)
+{
+  int e;
+  char *path;
+
+  if (client->state != REACTOR_HTTP_CLIENT_IDLE)
+    return -1;
+
+  e = reactor_http_client_target(client, uri, &path);
+  if (e == -1)
+    return -1;
+
+  reactor_http_request_clear(&client->request);
+  reactor_http_request_create(&client->request, client->host, client->service, method, path, content, content_size);
+  reactor_http_request_add_header(&client->request, "Connection", "keep-alive");
+  client->flags = flags;
+  client->received = 0;
+  reactor_http_parser_open_response(&client->parser, &client->response, reactor_http_client_flags(method, flags));
+
+  client->state = REACTOR_HTTP_CLIENT_CONNECTED;
+  reactor_http_request_send(&client->request, &client->stream);
+  reactor_stream_flush(&client->stream);
+  return 0;
+}
+
 void reactor_http_client_close(reactor_http_client *client)
 {
   if (client->state == REACTOR_HTTP_CLIENT_CLOSED)
     return;
 
+  if (client->state == REACTOR_HTTP_CLIENT_RESOLVING)
+    {
+      reactor_http_resolver_cancel(client->resolver, reactor_http_client_resolver_event, client);
+      reactor_http_parser_close(&client->parser);
+      client->state = REACTOR_HTTP_CLIENT_CLOSING;
+    }
+
   if (client->state != REACTOR_HTTP_CLIENT_CLOSING)
     {
       client->state = REACTOR_HTTP_CLIENT_CLOSING;
@@ -74,19 +175,187 @@ void reactor_http_client_close(reactor_http_client *client)
       client->stream.state == REACTOR_STREAM_CLOSED)
     {
       client->state = REACTOR_HTTP_CLIENT_CLOSED;
-      free(client->uri);
+      while (vector_size(&client->exchanges))
+        reactor_http_client_pipeline_next(client, NULL);
+      vector_clear(&client->exchanges);
+      client->depth = 0;
+      buffer_clear(&client->uri);
       reactor_http_request_clear(&client->request);
       reactor_http_response_clear(&client->response);
       reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_CLOSE, NULL);
+      if (client->pool)
+        reactor_http_client_pool_remove(client->pool, client);
     }
 }
 
+int reactor_http_client_reusable(reactor_http_client *client)
+{
+  reactor_http_response *response;
+  char *value;
+  size_t size;
+
+  response = &client->response;
+  if (!client->pool || client->state != REACTOR_HTTP_CLIENT_CONNECTED || response->minor_version == 0)
+    return 0;
+
+  /* a body delimited by the connection closing cannot leave the connection reusable */
+  if (!(client->parser.flags & REACTOR_HTTP_PARSER_FLAGS_HEAD) && response->status / 100 != 1 &&
+      response->status != 204 && response->status != 304 &&
+      !response->known[REACTOR_HTTP_FIELD_CONTENT_LENGTH] && !response->known[REACTOR_HTTP_FIELD_TRANSFER_ENCODING])
+    return 0;
+
+  value = reactor_http_response_field_id(response, REACTOR_HTTP_FIELD_CONNECTION, &size);
+  return !value || !reactor_http_token(value, size, "close");
+}
+
+int reactor_http_client_retry(reactor_http_client *client)
+{
+  reactor_user user;
+  char *method;
+  int e;
+
+  method = client->request.method;
+  if (!client->pool || !client->reused || client->received || client->depth || client->state != REACTOR_HTTP_CLIENT_CONNECTED ||
+      !method || !(strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0 || strcmp(method, "OPTIONS") == 0 ||
+                   strcmp(method, "PUT") == 0 || strcmp(method, "DELETE") == 0))
+    return 0;
+
+  /* the server closed an idle connection just as it was reused, an idempotent request is sent again on a new one */
+  user = client->user;
+  e = reactor_http_client_pool_connect(client->pool, user.call, user.state, method, buffer_data(&client->uri),
+                                       client->request.content, client->request.content_size, client->flags);
+  if (e == -1)
+    return 0;
+
+  reactor_user_init(&client->user, reactor_http_client_pool_client_event, client->pool);
+  reactor_http_client_close(client);
+  return 1;
+}
+
+int reactor_http_client_flags(char *method, int flags)
+{
+  if (method && strcmp(method, "HEAD") == 0)
+    return flags | REACTOR_HTTP_PARSER_FLAGS_HEAD;
+  return flags & ~REACTOR_HTTP_PARSER_FLAGS_HEAD;
+}
+
 void reactor_http_client_error(reactor_http_client *client)
 {
   if (client->state == REACTOR_HTTP_CLIENT_CONNECTED)
     reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_ERROR, NULL);
 }
 
+int reactor_http_client_pipeline_open(reactor_http_client *client, char *uri, size_t depth, int flags)
+{
+  int e;
+  char *path;
+
+  if (client->state != REACTOR_HTTP_CLIENT_CLOSED)
+    return -1;
+
+  e = reactor_http_client_target(client, uri, &path);
+  if (e == -1)
+    return -1;
+
+  client->depth = depth ? depth : REACTOR_HTTP_CLIENT_PIPELINE_DEPTH;
+  reactor_http_parser_open_response(&client->parser, &client->response, flags);
+  return reactor_http_client_connect(client);
+}
+
+int reactor_http_client_pipeline_request(reactor_http_client *client, char *method, char *path,
+                                         char *content, size_t content_size, void *state)
+{
+  reactor_http_client_exchange *exchange;
+  int e;
+
+  if (!client->depth ||
+      (client->state != REACTOR_HTTP_CLIENT_CONNECTING && client->state != REACTOR_HTTP_CLIENT_CONNECTED) ||
+      vector_size(&client->exchanges) >= client->depth)
+    return -1;
+
+  e = vector_push_back(&client->exchanges, (reactor_http_client_exchange[]) {{.state = state}});
+  if (e == -1)
+    return -1;
+
+  exchange = vector_back(&client->exchanges);
+  reactor_http_request_create(&exchange->request, client->host, client->service, method,
+                              path[0] == '/' ? path + 1 : path, content, content_size);
+  if (vector_size(&client->exchanges) == 1)
+    reactor_http_client_pipeline_head(client);
+  if (client->state == REACTOR_HTTP_CLIENT_CONNECTED)
+    reactor_http_request_send(&exchange->request, &client->stream);
+  return 0;
+}
+
+void reactor_http_client_pipeline_flush(reactor_http_client *client)
+{
+  if (client->state == REACTOR_HTTP_CLIENT_CONNECTED)
+    reactor_stream_flush(&client->stream);
+}
+
+void reactor_http_client_pipeline_send(reactor_http_client *client)
+{
+  size_t i;
+
+  /* requests queued while connecting are written back to back */
+  for (i = 0; i < vector_size(&client->exchanges); i ++)
+    reactor_http_request_send(&((reactor_http_client_exchange *) vector_at(&client->exchanges, i))->request,
+                              &client->stream);
+}
+
+void reactor_http_client_pipeline_next(reactor_http_client *client, reactor_http_response *response)
+{
+  reactor_http_client_exchange exchange;
+
+  if (!vector_size(&client->exchanges))
+    {
+      reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_ERROR, NULL);
+      reactor_http_client_close(client);
+      return;
+    }
+
+  /* responses arrive in request order, a NULL response means the request was never answered */
+  exchange = *(reactor_http_client_exchange *) vector_front(&client->exchanges);
+  vector_erase(&client->exchanges, 0, 1);
+  exchange.response = response;
+  reactor_http_client_pipeline_head(client);
+  reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_PIPELINE_RESPONSE, &exchange);
+  reactor_http_request_clear(&exchange.request);
+}
+
+void reactor_http_client_pipeline_head(reactor_http_client *client)
+{
+  reactor_http_client_exchange *exchange;
+
+  /* the parser has to know whether the response it waits for answers a HEAD request */
+  exchange = vector_size(&client->exchanges) ? vector_front(&client->exchanges) : NULL;
+  client->parser.flags = reactor_http_client_flags(exchange ? exchange->request.method : NULL, client->parser.flags);
+}
+
+void reactor_http_client_resolver_event(void *state, int type, void *data)
+{
+  reactor_http_client *client;
+  reactor_http_resolver_result *result;
+  int e;
+
+  client = state;
+  result = data;
+  if (client->state != REACTOR_HTTP_CLIENT_RESOLVING)
+    return;
+
+  e = -1;
+  if (type == REACTOR_HTTP_RESOLVER_RESULT)
+    e = reactor_tcp_client_open(&client->tcp_client, &client->stream, result->address, client->service);
+  if (e == -1)
+    {
+      reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_ERROR, NULL);
+      reactor_http_client_close(client);
+      return;
+    }
+
+  client->state = REACTOR_HTTP_CLIENT_CONNECTING;
+}
+
 void reactor_http_client_tcp_client_event(void *state, int type, void *data)
 {
   reactor_http_client *client;
@@ -108,7 +377,6 @@ void reactor_http_client_tcp_client_event(void *state, int type, void *data)
 void reactor_http_client_stream_event(void *state, int type, void *data)
 {
   reactor_http_client *client;
-  reactor_stream_data *in;
 
   client = state;
 
@@ -116,19 +384,25 @@ void reactor_http_client_stream_event(void *state, int type, void *data)
     {
     case REACTOR_STREAM_CONNECT:
       client->state = REACTOR_HTTP_CLIENT_CONNECTED;
-      reactor_http_request_send(&client->request, &client->stream);
+      if (client->depth)
+        reactor_http_client_pipeline_send(client);
+      else
+        reactor_http_request_send(&client->request, &client->stream);
       break;
     case REACTOR_STREAM_DATA:
-      in = data;
-      reactor_http_parser_data(&client->parser, in);
+      reactor_http_client_data(client, data);
       break;
     case REACTOR_STREAM_CLOSE:
       reactor_http_client_close(client);
       break;
     case REACTOR_STREAM_END:
+      if (reactor_http_client_retry(client))
+        break;
       reactor_http_client_close(client);
       break;
     case REACTOR_STREAM_ERROR:
+      if (reactor_http_client_retry(client))
+        break;
       reactor_http_client_error(client);
       reactor_http_client_close(client);
       break;
@@ -138,6 +412,22 @@ void reactor_http_client_stream_event(void *state, int type, void *data)
     }
 }
 
+void reactor_http_client_data(reactor_http_client *client, reactor_stream_data *data)
+{
+  size_t size;
+
+  client->received = 1;
+
+  /* the parser completes at most one message per call, keep going while pipelined responses remain */
+  do
+    {
+      size = data->size;
+      reactor_http_parser_data(&client->parser, data);
+    }
+  while (data->size && data->size < size && client->parser.state == REACTOR_HTTP_PARSER_RESPONSE_HEADER &&
+         client->state == REACTOR_HTTP_CLIENT_CONNECTED);
+}
+
 void reactor_http_client_parser_event(void *state, int type, void *data)
 {
   reactor_http_client *client;
@@ -150,10 +440,22 @@ void reactor_http_client_parser_event(void *state, int type, void *data)
       reactor_http_client_close(client);
       break;
     case REACTOR_HTTP_PARSER_DONE:
+      if (client->depth)
+        {
+          reactor_http_client_pipeline_next(client, &client->response);
+          break;
+        }
+      if (!(client->parser.flags & REACTOR_HTTP_PARSER_FLAGS_STREAM))
+        client->keep = reactor_http_client_reusable(client);
       reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_RESPONSE, &client->response);
-      reactor_http_client_close(client);
+      if (client->keep && client->state == REACTOR_HTTP_CLIENT_CONNECTED)
+        reactor_http_client_pool_release(client->pool, client);
+      else
+        reactor_http_client_close(client);
       break;
     case REACTOR_HTTP_PARSER_HEADER:
+      /* the header of a streamed response is gone by the time it is done */
+      client->keep = reactor_http_client_reusable(client);
       reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_HEADER, &client->response);
       break;
     case REACTOR_HTTP_PARSER_CHUNK:
@@ -7,7 +7,8 @@ enum reactor_http_client_event
   REACTOR_HTTP_CLIENT_RESPONSE,
   REACTOR_HTTP_CLIENT_HEADER,
   REACTOR_HTTP_CLIENT_CHUNK,
-  REACTOR_HTTP_CLIENT_CLOSE
+  REACTOR_HTTP_CLIENT_CLOSE,
+  REACTOR_HTTP_CLIENT_PIPELINE_RESPONSE
 };
 
 enum reactor_http_client_state
@@ -15,7 +16,23 @@ enum reactor_http_client_state
   REACTOR_HTTP_CLIENT_CLOSED,
   REACTOR_HTTP_CLIENT_CONNECTING,
   REACTOR_HTTP_CLIENT_CONNECTED,
-  REACTOR_HTTP_CLIENT_CLOSING
+  REACTOR_HTTP_CLIENT_CLOSING,
+  REACTOR_HTTP_CLIENT_IDLE,
+  REACTOR_HTTP_CLIENT_RESOLVING
+};
+
+#ifndef REACTOR_HTTP_CLIENT_PIPELINE_DEPTH
+#define REACTOR_HTTP_CLIENT_PIPELINE_DEPTH 16
+#endif /* REACTOR_HTTP_CLIENT_PIPELINE_DEPTH */
+
+typedef struct reactor_http_client_pool reactor_http_client_pool;
+
+typedef struct reactor_http_client_exchange reactor_http_client_exchange;
+struct reactor_http_client_exchange
+{
+  void                  *state;
+  reactor_http_request   request;
+  reactor_http_response *response;
 };
 
 typedef struct reactor_http_client reactor_http_client;
@@ -23,20 +40,48 @@ struct reactor_http_client
 {
   int                    state;
   reactor_user           user;
-  char                  *uri;
+  buffer                 uri;
+  reactor_http_url       url;
   reactor_tcp_client     tcp_client;
   reactor_stream         stream;
   reactor_http_request   request;
   reactor_http_response  response;
   reactor_http_parser    parser;
+  char                  *key;
+  time_t                 idle;
+  reactor_http_client_pool *pool;
+  reactor_http_resolver *resolver;
+  char                  *host;
+  char                  *service;
+  size_t                 depth;
+  vector                 exchanges;
+  int                    flags;
+  int                    keep;
+  int                    reused;
+  int                    received;
 };
 
 void  reactor_http_client_init(reactor_http_client *, reactor_user_call *, void *);
 int   reactor_http_client_open(reactor_http_client *, char *, char *, char *, size_t, int);
+int   reactor_http_client_target(reactor_http_client *, char *, char **);
+void  reactor_http_client_resolver(reactor_http_client *, reactor_http_resolver *);
+int   reactor_http_client_connect(reactor_http_client *);
+int   reactor_http_client_send(reactor_http_client *, char *, char *, char *, size_t, int);
 void  reactor_http_client_close(reactor_http_client *);
+int   reactor_http_client_reusable(reactor_http_client *);
+int   reactor_http_client_retry(reactor_http_client *);
+int   reactor_http_client_flags(char *, int);
+void  reactor_http_client_pipeline_head(reactor_http_client *);
 void  reactor_http_client_error(reactor_http_client *);
+int   reactor_http_client_pipeline_open(reactor_http_client *, char *, size_t, int);
+int   reactor_http_client_pipeline_request(reactor_http_client *, char *, char *, char *, size_t, void *);
+void  reactor_http_client_pipeline_flush(reactor_http_client *);
+void  reactor_http_client_pipeline_send(reactor_http_client *);
+void  reactor_http_client_pipeline_next(reactor_http_client *, reactor_http_response *);
+void  reactor_http_client_resolver_event(void *, int, void *);
 void  reactor_http_client_tcp_client_event(void *, int, void *);
 void  reactor_http_client_stream_event(void *, int, void *);
+void  reactor_http_client_data(reactor_http_client *, reactor_stream_data *);
 void  reactor_http_client_parser_event(void *, int, void *);
 
 #endif /* REACTOR_HTTP_CLIENT_H_INCLUDED */
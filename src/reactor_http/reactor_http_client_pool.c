@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <dynamic.h>
+#include <clo.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+#include "reactor_http_parser.h"
+#include "reactor_http_resolver.h"
+#include "reactor_http_client.h"
+#include "reactor_http_client_pool.h"
+
+void reactor_http_client_pool_init(reactor_http_client_pool *pool)
+{
+  *pool = (reactor_http_client_pool) {.state = REACTOR_HTTP_CLIENT_POOL_CLOSED,
+                                      .max_idle = REACTOR_HTTP_CLIENT_POOL_IDLE_MAX,
+                                      .max_per_host = REACTOR_HTTP_CLIENT_POOL_HOST_MAX,
+                                      .timeout = REACTOR_HTTP_CLIENT_POOL_TIMEOUT};
+  vector_init(&pool->idle, sizeof(reactor_http_client *));
+  vector_init(&pool->closed, sizeof(reactor_http_client *));
+  reactor_timer_init(&pool->timer, reactor_http_client_pool_timer_event, pool);
+}
+
+void reactor_http_client_pool_limits(reactor_http_client_pool *pool, size_t max_idle, size_t max_per_host, time_t timeout)
+{
+  pool->max_idle = max_idle;
+  pool->max_per_host = max_per_host;
+  pool->timeout = timeout;
+}
+
+void reactor_http_client_pool_resolver(reactor_http_client_pool *pool, reactor_http_resolver *resolver)
+{
+  pool->resolver = resolver;
+}
+
+int reactor_http_client_pool_open(reactor_http_client_pool *pool)
+{
+  int e;
+
+  if (pool->state != REACTOR_HTTP_CLIENT_POOL_CLOSED)
+    return -1;
+
+  e = reactor_timer_open(&pool->timer, 1000000000, 1000000000);
+  if (e == -1)
+    return -1;
+
+  pool->now = time(NULL);
+  pool->state = REACTOR_HTTP_CLIENT_POOL_OPEN;
+  return 0;
+}
+
+void reactor_http_client_pool_close(reactor_http_client_pool *pool)
+{
+  reactor_http_client *client;
+
+  if (pool->state != REACTOR_HTTP_CLIENT_POOL_OPEN)
+    return;
+
+  /* clients still serving a request close when their response is done */
+  pool->state = REACTOR_HTTP_CLIENT_POOL_CLOSING;
+  while (vector_size(&pool->idle))
+    {
+      client = *(reactor_http_client **) vector_back(&pool->idle);
+      vector_pop_back(&pool->idle);
+      reactor_http_client_close(client);
+    }
+}
+
+int reactor_http_client_pool_request(reactor_http_client_pool *pool, reactor_user_call *call, void *state,
+                                     char *method, char *uri, char *content, size_t content_size, int flags)
+{
+  reactor_http_client *client;
+  char *key;
+  size_t i;
+  int e;
+
+  if (pool->state != REACTOR_HTTP_CLIENT_POOL_OPEN)
+    return -1;
+
+  key = reactor_http_client_pool_key(uri);
+  if (!key)
+    return -1;
+
+  /* most recently released first, so the oldest idle connections are the ones left to time out */
+  for (i = vector_size(&pool->idle); i > 0; i --)
+    {
+      client = *(reactor_http_client **) vector_at(&pool->idle, i - 1);
+      if (client->state == REACTOR_HTTP_CLIENT_IDLE && strcmp(client->key, key) == 0)
+        {
+          free(key);
+          vector_erase(&pool->idle, i - 1, i);
+          e = reactor_http_client_send(client, method, uri, content, content_size, flags);
+          if (e == -1)
+            {
+              reactor_http_client_close(client);
+              return -1;
+            }
+          reactor_user_init(&client->user, call, state);
+          client->reused = 1;
+          pool->hits ++;
+          return 0;
+        }
+    }
+  free(key);
+
+  return reactor_http_client_pool_connect(pool, call, state, method, uri, content, content_size, flags);
+}
+
+int reactor_http_client_pool_connect(reactor_http_client_pool *pool, reactor_user_call *call, void *state,
+                                     char *method, char *uri, char *content, size_t content_size, int flags)
+{
+  reactor_http_client *client;
+  char *key;
+  int e;
+
+  if (pool->state != REACTOR_HTTP_CLIENT_POOL_OPEN)
+    return -1;
+
+  key = reactor_http_client_pool_key(uri);
+  if (!key)
+    return -1;
+
+  client = malloc(sizeof *client);
+  if (!client)
+    {
+      free(key);
+      return -1;
+    }
+
+  reactor_http_client_init(client, call, state);
+  client->pool = pool;
+  client->key = key;
+  client->resolver = pool->resolver;
+  e = reactor_http_client_open(client, method, uri, content, content_size, flags);
+  if (e == -1)
+    {
+      buffer_clear(&client->uri);
+      reactor_http_request_clear(&client->request);
+      free(client->key);
+      free(client);
+      return -1;
+    }
+
+  pool->clients ++;
+  pool->misses ++;
+  return 0;
+}
+
+void reactor_http_client_pool_release(reactor_http_client_pool *pool, reactor_http_client *client)
+{
+  reactor_http_client *other;
+  size_t i, same;
+  int e;
+
+  reactor_user_dispatch(&client->user, REACTOR_HTTP_CLIENT_CLOSE, NULL);
+  reactor_user_init(&client->user, reactor_http_client_pool_client_event, pool);
+  client->state = REACTOR_HTTP_CLIENT_IDLE;
+  client->idle = pool->now;
+
+  for (i = 0, same = 0; i < vector_size(&pool->idle); i ++)
+    {
+      other = *(reactor_http_client **) vector_at(&pool->idle, i);
+      if (strcmp(other->key, client->key) == 0)
+        same ++;
+    }
+
+  if (pool->state != REACTOR_HTTP_CLIENT_POOL_OPEN || same >= pool->max_per_host || !pool->max_idle)
+    {
+      reactor_http_client_close(client);
+      return;
+    }
+
+  if (vector_size(&pool->idle) >= pool->max_idle)
+    {
+      other = *(reactor_http_client **) vector_front(&pool->idle);
+      vector_erase(&pool->idle, 0, 1);
+      reactor_http_client_close(other);
+    }
+
+  /* a client that cannot be tracked as idle would never be reaped */
+  e = vector_push_back(&pool->idle, &client);
+  if (e == -1)
+    reactor_http_client_close(client);
+}
+
+void reactor_http_client_pool_remove(reactor_http_client_pool *pool, reactor_http_client *client)
+{
+  size_t i;
+
+  for (i = 0; i < vector_size(&pool->idle); i ++)
+    if (*(reactor_http_client **) vector_at(&pool->idle, i) == client)
+      {
+        vector_erase(&pool->idle, i, i + 1);
+        break;
+      }
+
+  /* the client is still on the call stack of its own close, so it is freed on the next tick */
+  vector_push_back(&pool->closed, &client);
+  pool->clients --;
+}
+
+void reactor_http_client_pool_reap(reactor_http_client_pool *pool)
+{
+  reactor_http_client *client;
+  size_t i;
+
+  for (i = 0; i < vector_size(&pool->closed); i ++)
+    {
+      client = *(reactor_http_client **) vector_at(&pool->closed, i);
+      free(client->key);
+      free(client);
+    }
+  vector_erase(&pool->closed, 0, vector_size(&pool->closed));
+
+  while (vector_size(&pool->idle))
+    {
+      client = *(reactor_http_client **) vector_front(&pool->idle);
+      if (pool->now - client->idle < pool->timeout)
+        break;
+      vector_erase(&pool->idle, 0, 1);
+      reactor_http_client_close(client);
+    }
+}
+
+char *reactor_http_client_pool_key(char *uri)
+{
+  reactor_http_url url;
+  char *key;
+  int e;
+
+  e = reactor_http_url_parse(&url, uri, strlen(uri));
+  if (e == -1 || !url.scheme.size)
+    return NULL;
+
+  e = asprintf(&key, "%.*s:%.*s", (int) url.host.size, uri + url.host.offset,
+               url.port.size ? (int) url.port.size : 2, url.port.size ? uri + url.port.offset : "80");
+  return e == -1 ? NULL : key;
+}
+
+void reactor_http_client_pool_timer_event(void *state, int type, void *data)
+{
+  reactor_http_client_pool *pool;
+
+  (void) data;
+  pool = state;
+  switch (type)
+    {
+    case REACTOR_TIMER_TIMEOUT:
+      pool->now = time(NULL);
+      reactor_http_client_pool_reap(pool);
+      if (pool->state == REACTOR_HTTP_CLIENT_POOL_CLOSING && !pool->clients)
+        reactor_timer_close(&pool->timer);
+      break;
+    case REACTOR_TIMER_CLOSE:
+      reactor_http_client_pool_reap(pool);
+      vector_clear(&pool->idle);
+      vector_clear(&pool->closed);
+      pool->state = REACTOR_HTTP_CLIENT_POOL_CLOSED;
+      break;
+    }
+}
+
+void reactor_http_client_pool_client_event(void *state, int type, void *data)
+{
+  /* idle clients have no user, closing is handled through reactor_http_client_pool_remove */
+  (void) state;
+  (void) type;
+  (void) data;
+}
@@ -0,0 +1,53 @@
+#ifndef REACTOR_HTTP_CLIENT_POOL_H_INCLUDED
+#define REACTOR_HTTP_CLIENT_POOL_H_INCLUDED
+
+#ifndef REACTOR_HTTP_CLIENT_POOL_IDLE_MAX
+#define REACTOR_HTTP_CLIENT_POOL_IDLE_MAX 64
+#endif /* REACTOR_HTTP_CLIENT_POOL_IDLE_MAX */
+
+#ifndef REACTOR_HTTP_CLIENT_POOL_HOST_MAX
+#define REACTOR_HTTP_CLIENT_POOL_HOST_MAX 8
+#endif /* REACTOR_HTTP_CLIENT_POOL_HOST_MAX */
+
+#ifndef REACTOR_HTTP_CLIENT_POOL_TIMEOUT
+#define REACTOR_HTTP_CLIENT_POOL_TIMEOUT 30
+#endif /* REACTOR_HTTP_CLIENT_POOL_TIMEOUT */
+
+enum reactor_http_client_pool_state
+{
+  REACTOR_HTTP_CLIENT_POOL_CLOSED,
+  REACTOR_HTTP_CLIENT_POOL_OPEN,
+  REACTOR_HTTP_CLIENT_POOL_CLOSING
+};
+
+struct reactor_http_client_pool
+{
+  int                    state;
+  size_t                 max_idle;
+  size_t                 max_per_host;
+  time_t                 timeout;
+  time_t                 now;
+  size_t                 clients;
+  vector                 idle;
+  vector                 closed;
+  reactor_timer          timer;
+  reactor_http_resolver *resolver;
+  size_t                 hits;
+  size_t                 misses;
+};
+
+void  reactor_http_client_pool_init(reactor_http_client_pool *);
+void  reactor_http_client_pool_limits(reactor_http_client_pool *, size_t, size_t, time_t);
+void  reactor_http_client_pool_resolver(reactor_http_client_pool *, reactor_http_resolver *);
+int   reactor_http_client_pool_open(reactor_http_client_pool *);
+void  reactor_http_client_pool_close(reactor_http_client_pool *);
+int   reactor_http_client_pool_request(reactor_http_client_pool *, reactor_user_call *, void *, char *, char *, char *, size_t, int);
+int   reactor_http_client_pool_connect(reactor_http_client_pool *, reactor_user_call *, void *, char *, char *, char *, size_t, int);
+void  reactor_http_client_pool_release(reactor_http_client_pool *, reactor_http_client *);
+void  reactor_http_client_pool_remove(reactor_http_client_pool *, reactor_http_client *);
+void  reactor_http_client_pool_reap(reactor_http_client_pool *);
+char *reactor_http_client_pool_key(char *);
+void  reactor_http_client_pool_timer_event(void *, int, void *);
+void  reactor_http_client_pool_client_event(void *, int, void *);
+
+#endif /* REACTOR_HTTP_CLIENT_POOL_H_INCLUDED */
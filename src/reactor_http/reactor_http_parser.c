@@ -9,6 +9,8 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/param.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <netdb.h>
 
 #include <dynamic.h>
@@ -18,10 +20,15 @@
 #include "reactor_http.h"
 #include "reactor_http_parser.h"
 
+int reactor_http_parser_fields(reactor_http_parser *, vector *, vector *, uint8_t *, struct phr_header *, size_t, int *, size_t *);
+int reactor_http_parser_framing(reactor_http_parser *);
+
 void reactor_http_parser_init(reactor_http_parser *parser, reactor_user_call *call, void *state)
 {
-  *parser = (reactor_http_parser) {.state = REACTOR_HTTP_PARSER_CLOSED};
+  *parser = (reactor_http_parser) {.state = REACTOR_HTTP_PARSER_CLOSED, .spill_fd = -1, .header_max = REACTOR_HTTP_PARSER_HEADER_MAX,
+                                   .fields_max = REACTOR_HTTP_PARSER_MAX_FIELDS, .uri_max = REACTOR_HTTP_PARSER_URI_MAX};
   reactor_user_init(&parser->user, call, state);
+  buffer_init(&parser->spill_header);
 }
 
 void reactor_http_parser_open_response(reactor_http_parser *parser, reactor_http_response *response, int flags)
@@ -29,6 +36,8 @@ void reactor_http_parser_open_response(reactor_http_parser *parser, reactor_http
   parser->state = REACTOR_HTTP_PARSER_RESPONSE_HEADER;
   parser->flags = flags | REACTOR_HTTP_PARSER_FLAGS_RESPONSE;
   parser->response = response;
+  parser->header_checked = 0;
+  parser->status = 0;
 }
 
 void reactor_http_parser_open_request(reactor_http_parser *parser, reactor_http_request *request, int flags)
@@ -36,6 +45,8 @@ void reactor_http_parser_open_request(reactor_http_parser *parser, reactor_http_
   parser->state = REACTOR_HTTP_PARSER_REQUEST_HEADER;
   parser->flags = flags;
   parser->request = request;
+  parser->header_checked = 0;
+  parser->status = 0;
 }
 
 void reactor_http_parser_error(reactor_http_parser *parser)
@@ -47,9 +58,104 @@ void reactor_http_parser_error(reactor_http_parser *parser)
   reactor_http_parser_close(parser);
 }
 
+void reactor_http_parser_reject(reactor_http_parser *parser, unsigned status)
+{
+  parser->status = status;
+  reactor_http_parser_error(parser);
+}
+
+void reactor_http_parser_limits(reactor_http_parser *parser, size_t header, size_t fields, size_t uri, size_t body)
+{
+  parser->header_max = header;
+  parser->fields_max = fields && fields < REACTOR_HTTP_PARSER_MAX_FIELDS ? fields : REACTOR_HTTP_PARSER_MAX_FIELDS;
+  parser->uri_max = uri;
+  parser->body_max = body;
+}
+
 void reactor_http_parser_close(reactor_http_parser *parser)
 {
   parser->state = REACTOR_HTTP_PARSER_CLOSED;
+  reactor_http_parser_spill_close(parser);
+  buffer_clear(&parser->spill_header);
+}
+
+void reactor_http_parser_spill(reactor_http_parser *parser, size_t size)
+{
+  parser->spill_size = size;
+}
+
+int reactor_http_parser_spill_open(reactor_http_parser *parser, reactor_stream_data *data)
+{
+  int e;
+
+  parser->spill_fd = memfd_create("reactor_http", MFD_CLOEXEC);
+  if (parser->spill_fd == -1)
+    parser->spill_fd = open("/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  if (parser->spill_fd == -1)
+    return -1;
+
+  /* the header moves out of the stream buffer so the body can be consumed as it is written */
+  parser->spill_written = 0;
+  buffer_erase(&parser->spill_header, 0, buffer_size(&parser->spill_header));
+  e = buffer_insert(&parser->spill_header, 0, data->base, parser->content_begin);
+  if (e == -1)
+    {
+      reactor_http_parser_spill_close(parser);
+      return -1;
+    }
+
+  return 0;
+}
+
+int reactor_http_parser_spill_begin(reactor_http_parser *parser, reactor_stream_data *data, size_t content_size, size_t consumed)
+{
+  int e;
+
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM || !parser->spill_size || content_size <= parser->spill_size ||
+      parser->spill_fd >= 0)
+    return 0;
+
+  e = reactor_http_parser_spill_open(parser, data);
+  if (e == 0)
+    e = reactor_http_parser_spill_write(parser, data->base + parser->content_begin, parser->content_end - parser->content_begin);
+  if (e == -1)
+    {
+      reactor_http_parser_error(parser);
+      return -1;
+    }
+
+  reactor_stream_data_consume(data, consumed);
+  parser->content_begin = 0;
+  parser->content_end = 0;
+  return 0;
+}
+
+int reactor_http_parser_spill_write(reactor_http_parser *parser, char *data, size_t size)
+{
+  ssize_t n;
+
+  while (size)
+    {
+      n = write(parser->spill_fd, data, size);
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          return -1;
+        }
+      data += n;
+      size -= n;
+      parser->spill_written += n;
+    }
+
+  return 0;
+}
+
+void reactor_http_parser_spill_close(reactor_http_parser *parser)
+{
+  if (parser->spill_fd >= 0)
+    (void) close(parser->spill_fd);
+  parser->spill_fd = -1;
 }
 
 void reactor_http_parser_data(reactor_http_parser *parser, reactor_stream_data *data)
@@ -79,45 +185,131 @@ void reactor_http_parser_data(reactor_http_parser *parser, reactor_stream_data *
 void reactor_http_parser_request_header(reactor_http_parser *parser, reactor_stream_data *data)
 {
   reactor_http_request *request;
-  size_t fields_count, method_size, path_size,  i;
-  struct phr_header fields[REACTOR_HTTP_PARSER_MAX_FIELDS];
-  int n;
-  char *value;
+  size_t fields_count, method_size, path_size, content_size;
+  struct phr_header fields[REACTOR_HTTP_PARSER_MAX_FIELDS + 1], *field;
+  const char *method, *path;
+  int n, e, chunked;
 
   request = parser->request;
   parser->base = data->base;
-  fields_count = REACTOR_HTTP_PARSER_MAX_FIELDS;
+
+  /* one slot more than allowed, so a filled extra slot tells too many fields apart from a malformed one */
+  fields_count = parser->fields_max + 1;
   n = phr_parse_request(data->base, data->size,
-                        (const char **) &request->method, &method_size,
-                        (const char **) &request->path, &path_size,
+                        &method, &method_size,
+                        &path, &path_size,
                         &request->minor_version,
-                        fields, &fields_count, 0);
-  if (n < 0)
+                        fields, &fields_count, parser->header_checked);
+
+  /* limits are checked before anything is buffered or dispatched, the session answers with parser->status */
+  if (n == -1)
     {
-      if (n == -1)
-        reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_ERROR, NULL);
+      reactor_http_parser_reject(parser, fields_count > parser->fields_max ? 431 : 400);
+      return;
+    }
+  if (parser->header_max && (n == -2 ? data->size : (size_t) n) > parser->header_max)
+    {
+      reactor_http_parser_reject(parser, 431);
       return;
     }
+  if (n == -2)
+    {
+      parser->header_checked = data->size;
+      return;
+    }
+  if (fields_count > parser->fields_max)
+    {
+      reactor_http_parser_reject(parser, 431);
+      return;
+    }
+  parser->header_checked = 0;
+  if (parser->uri_max && path_size > parser->uri_max)
+    {
+      reactor_http_parser_reject(parser, 414);
+      return;
+    }
+  reactor_http_parser_spill_close(parser);
 
-  request->method[method_size] = '\0';
-  request->path[path_size] = '\0';
-  for (i = 0; i < fields_count; i ++)
-    reactor_http_field_add_range(&request->fields, (char *) fields[i].name, fields[i].name_len,
-                                 (char *) fields[i].value, fields[i].value_len);
+  request->method_range = (reactor_http_range) {.offset = method - data->base, .size = method_size};
+  request->path_range = (reactor_http_range) {.offset = path - data->base, .size = path_size};
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_RANGES)
+    {
+      request->method = NULL;
+      request->path = NULL;
+    }
+  else
+    {
+      request->method = (char *) method;
+      request->path = (char *) path;
+      request->method[method_size] = '\0';
+      request->path[path_size] = '\0';
+    }
+
+  e = reactor_http_parser_fields(parser, &request->fields, &request->ranges, request->known, fields, fields_count, &chunked, &content_size);
+  if (e == -1)
+    {
+      reactor_http_parser_error(parser);
+      return;
+    }
+  if (parser->body_max && !chunked && content_size > parser->body_max)
+    {
+      reactor_http_parser_reject(parser, 413);
+      return;
+    }
+  parser->body_size = 0;
+
+  /* let the handler accept or refuse a body the client holds back, HTTP/1.0 expectations are ignored */
+  if (request->known[REACTOR_HTTP_FIELD_EXPECT] && request->minor_version >= 1)
+    {
+      field = &fields[request->known[REACTOR_HTTP_FIELD_EXPECT] - 1];
+      if (!reactor_http_token((char *) field->value, field->value_len, "100-continue"))
+        {
+          reactor_http_parser_reject(parser, 417);
+          return;
+        }
+      if ((chunked || content_size) && data->size == (size_t) n)
+        {
+          request->base = data->base;
+          request->content = NULL;
+          request->content_size = chunked ? 0 : content_size;
+          reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_EXPECT, request);
+          if (parser->state == REACTOR_HTTP_PARSER_CLOSED)
+            return;
+        }
+    }
+
+  /* the header handler may switch this request to stream mode, the header is then consumed before the body */
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_HEADER)
+    {
+      request->base = data->base;
+      request->content = NULL;
+      request->content_size = chunked ? 0 : content_size;
+      reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_HEADER, request);
+      if (parser->state == REACTOR_HTTP_PARSER_CLOSED)
+        return;
+      if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+        {
+          reactor_stream_data_consume(data, n);
+          n = 0;
+        }
+    }
 
   parser->content_begin = n;
   parser->content_end = n;
-  value = reactor_http_field_lookup(&request->fields, "transfer-encoding");
-  if (value && strcasecmp(value, "chunked") == 0)
+  if (!chunked && reactor_http_parser_spill_begin(parser, data, content_size, n) == -1)
+    return;
+  n = parser->content_begin;
+  if (chunked)
     {
       request->content_size = 0;
       parser->chunk_begin = n;
+      parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE_START;
+      parser->chunk_size = 0;
       parser->state = REACTOR_HTTP_PARSER_CHUNKED_BODY;
     }
   else
     {
-      value = reactor_http_field_lookup(&request->fields, "content-length");
-      request->content_size = value ? strtoul(value, NULL, 0) : 0;
+      request->content_size = content_size;
       parser->size = n + request->content_size;
       parser->state = REACTOR_HTTP_PARSER_BODY;
     }
@@ -128,10 +320,10 @@ void reactor_http_parser_request_header(reactor_http_parser *parser, reactor_str
 void reactor_http_parser_response_header(reactor_http_parser *parser, reactor_stream_data *data)
 {
   reactor_http_response *response;
-  size_t message_size, fields_count, i;
+  size_t message_size, fields_count, content_size;
   struct phr_header fields[REACTOR_HTTP_PARSER_MAX_FIELDS];
-  char *value;
-  int n;
+  const char *message;
+  int n, e, chunked;
 
   response = parser->response;
   parser->base = data->base;
@@ -139,22 +331,42 @@ void reactor_http_parser_response_header(reactor_http_parser *parser, reactor_st
   n = phr_parse_response(data->base, data->size,
                          &response->minor_version,
                          &response->status,
-                         (const char **) &response->message, &message_size,
-                         fields, &fields_count, 0);
+                         &message, &message_size,
+                         fields, &fields_count, parser->header_checked);
   if (n < 0)
     {
       if (n == -1)
         reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_ERROR, NULL);
+      else
+        parser->header_checked = data->size;
       return;
     }
+  parser->header_checked = 0;
+  reactor_http_parser_spill_close(parser);
 
-  for (i = 0; i < fields_count; i ++)
-    reactor_http_field_add_range(&response->fields, (char *) fields[i].name, fields[i].name_len,
-                                 (char *) fields[i].value, fields[i].value_len);
+  response->message_range = (reactor_http_range) {.offset = message - data->base, .size = message_size};
+  response->message = parser->flags & REACTOR_HTTP_PARSER_FLAGS_RANGES ? NULL : (char *) message;
+  e = reactor_http_parser_fields(parser, &response->fields, &response->ranges, response->known, fields, fields_count, &chunked, &content_size);
+  if (e == -1)
+    {
+      reactor_http_parser_error(parser);
+      return;
+    }
+  parser->body_size = 0;
+
+  /* responses to HEAD and 1xx, 204 and 304 responses never have a body, whatever their fields say */
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_HEAD || response->status / 100 == 1 ||
+      response->status == 204 || response->status == 304)
+    {
+      chunked = 0;
+      content_size = 0;
+    }
 
   if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
     {
-      reactor_http_parser_response_final(parser, data);
+      response->base = data->base;
+      response->content = NULL;
+      response->content_size = chunked ? 0 : content_size;
       reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_HEADER, &parser->response);
       reactor_stream_data_consume(data, n);
       n = 0;
@@ -162,17 +374,20 @@ void reactor_http_parser_response_header(reactor_http_parser *parser, reactor_st
 
   parser->content_begin = n;
   parser->content_end = n;
-  value = reactor_http_field_lookup(&response->fields, "transfer-encoding");
-  if (value && strcasecmp(value, "chunked") == 0)
+  if (!chunked && reactor_http_parser_spill_begin(parser, data, content_size, n) == -1)
+    return;
+  n = parser->content_begin;
+  if (chunked)
     {
       response->content_size = 0;
       parser->chunk_begin = n;
+      parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE_START;
+      parser->chunk_size = 0;
       parser->state = REACTOR_HTTP_PARSER_CHUNKED_BODY;
     }
   else
     {
-      value = reactor_http_field_lookup(&response->fields, "content-length");
-      response->content_size = value ? strtoul(value, NULL, 0) : 0;
+      response->content_size = content_size;
       parser->size = n + response->content_size;
       parser->state = REACTOR_HTTP_PARSER_BODY;
     }
@@ -180,14 +395,91 @@ void reactor_http_parser_response_header(reactor_http_parser *parser, reactor_st
   reactor_http_parser_data(parser, data);
 }
 
+int reactor_http_parser_fields(reactor_http_parser *parser, vector *pointers, vector *ranges, uint8_t *known,
+                               struct phr_header *fields, size_t fields_count, int *chunked, size_t *content_size)
+{
+  struct phr_header *field, *encoding;
+  size_t i;
+  int e, id;
+
+  encoding = NULL;
+  vector_erase(pointers, 0, vector_size(pointers));
+  vector_erase(ranges, 0, vector_size(ranges));
+  memset(known, 0, REACTOR_HTTP_FIELD_MAX);
+  for (i = 0; i < fields_count; i ++)
+    {
+      if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_RANGES)
+        e = reactor_http_range_add(ranges, parser->base, (char *) fields[i].name, fields[i].name_len,
+                                   (char *) fields[i].value, fields[i].value_len);
+      else
+        e = reactor_http_field_add_range(pointers, (char *) fields[i].name, fields[i].name_len,
+                                         (char *) fields[i].value, fields[i].value_len);
+      if (e == -1)
+        return -1;
+
+      id = reactor_http_field_id(fields[i].name, fields[i].name_len);
+      if (id == REACTOR_HTTP_FIELD_CONTENT_LENGTH && known[id])
+        return reactor_http_parser_framing(parser);
+      if (id == REACTOR_HTTP_FIELD_TRANSFER_ENCODING)
+        encoding = &fields[i];
+      if (id != REACTOR_HTTP_FIELD_UNKNOWN && !known[id] && i < UINT8_MAX)
+        known[id] = i + 1;
+    }
+
+  /* the message is only chunked if chunked is the final coding of the last Transfer-Encoding field */
+  *chunked = 0;
+  if (encoding)
+    {
+      for (i = encoding->value_len; i && encoding->value[i - 1] != ','; i --);
+      for (; i < encoding->value_len && (encoding->value[i] == ' ' || encoding->value[i] == '\t'); i ++);
+      if (!reactor_http_token((char *) encoding->value + i, encoding->value_len - i, "chunked") ||
+          known[REACTOR_HTTP_FIELD_CONTENT_LENGTH])
+        return reactor_http_parser_framing(parser);
+      *chunked = 1;
+    }
+
+  *content_size = 0;
+  if (known[REACTOR_HTTP_FIELD_CONTENT_LENGTH])
+    {
+      field = &fields[known[REACTOR_HTTP_FIELD_CONTENT_LENGTH] - 1];
+      if (!field->value_len)
+        return reactor_http_parser_framing(parser);
+      for (i = 0; i < field->value_len; i ++)
+        {
+          if (field->value[i] < '0' || field->value[i] > '9' ||
+              *content_size > (SIZE_MAX - (field->value[i] - '0')) / 10)
+            return reactor_http_parser_framing(parser);
+          *content_size = *content_size * 10 + field->value[i] - '0';
+        }
+    }
+
+  return 0;
+}
+
+int reactor_http_parser_framing(reactor_http_parser *parser)
+{
+  /* an ambiguous message length could make the next message start inside this one */
+  parser->status = 400;
+  return -1;
+}
+
 void reactor_http_parser_body(reactor_http_parser *parser, reactor_stream_data *data)
 {
   size_t size;
 
-  if (data->size && parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+  if (data->size && parser->size && (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM || parser->spill_fd >= 0))
     {
       size = MIN(parser->size, data->size);
-      reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_CHUNK, (reactor_stream_data[]){{.base = data->base, .size = size}});
+      if (parser->spill_fd >= 0)
+        {
+          if (reactor_http_parser_spill_write(parser, data->base, size) == -1)
+            {
+              reactor_http_parser_error(parser);
+              return;
+            }
+        }
+      else
+        reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_CHUNK, (reactor_stream_data[]){{.base = data->base, .size = size}});
       reactor_stream_data_consume(data, size);
       parser->size -= size;
     }
@@ -202,36 +494,191 @@ void reactor_http_parser_body(reactor_http_parser *parser, reactor_stream_data *
 
 void reactor_http_parser_chunked_body(reactor_http_parser *parser, reactor_stream_data *data)
 {
-  char *start, *end, *eol;
+  char *p, *end, *eol;
   size_t size;
+  int c;
 
-  start = data->base + parser->chunk_begin;
+  /* chunk_begin is the first unread byte and content_end the end of the compacted content, both persist across reads */
+  p = data->base + parser->chunk_begin;
   end = data->base + data->size;
-  eol = memmem(start, end - start, "\r\n", 2);
-  if (!eol)
+  while (p < end && parser->state == REACTOR_HTTP_PARSER_CHUNKED_BODY)
+    switch (parser->chunk_state)
+      {
+      case REACTOR_HTTP_PARSER_CHUNK_SIZE_START:
+      case REACTOR_HTTP_PARSER_CHUNK_SIZE:
+        if (parser->chunk_state == REACTOR_HTTP_PARSER_CHUNK_SIZE_START)
+          parser->chunk_line = 0;
+        c = reactor_http_hex(*p);
+        if (c == -1)
+          {
+            if (parser->chunk_state == REACTOR_HTTP_PARSER_CHUNK_SIZE_START)
+              {
+                reactor_http_parser_reject(parser, 400);
+                return;
+              }
+            parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE_END;
+            break;
+          }
+        if (parser->chunk_size > (SIZE_MAX >> 4) || (parser->header_max && parser->chunk_line >= parser->header_max))
+          {
+            reactor_http_parser_reject(parser, 400);
+            return;
+          }
+        parser->chunk_size = (parser->chunk_size << 4) | c;
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE;
+        parser->chunk_line ++;
+        p ++;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_SIZE_END:
+        /* the size may be followed by whitespace before an extension, and the line ends with CRLF or LF */
+        if (*p == ' ' || *p == '\t')
+          {
+            if (parser->header_max && parser->chunk_line >= parser->header_max)
+              {
+                reactor_http_parser_reject(parser, 400);
+                return;
+              }
+            parser->chunk_line ++;
+            p ++;
+          }
+        else if (*p == '\r')
+          {
+            parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE_LF;
+            parser->chunk_line ++;
+            p ++;
+          }
+        else if (*p == ';' || *p == '\n')
+          parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_EXTENSION;
+        else
+          {
+            reactor_http_parser_reject(parser, 400);
+            return;
+          }
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_SIZE_LF:
+        if (*p != '\n')
+          {
+            reactor_http_parser_reject(parser, 400);
+            return;
+          }
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_EXTENSION;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_EXTENSION:
+        /* the chunk size line stays in the input until the message is done, so its length is bounded like a header */
+        eol = memchr(p, '\n', end - p);
+        parser->chunk_line += (eol ? eol + 1 : end) - p;
+        if (parser->header_max && parser->chunk_line > parser->header_max)
+          {
+            reactor_http_parser_reject(parser, 400);
+            return;
+          }
+        if (!eol)
+          {
+            p = end;
+            break;
+          }
+        p = eol + 1;
+        parser->chunk_line = 0;
+        if (parser->body_max && parser->chunk_size > parser->body_max - parser->body_size)
+          {
+            reactor_http_parser_reject(parser, 413);
+            return;
+          }
+        parser->body_size += parser->chunk_size;
+        parser->chunk_state = parser->chunk_size ? REACTOR_HTTP_PARSER_CHUNK_DATA : REACTOR_HTTP_PARSER_CHUNK_TRAILER;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_DATA:
+        size = MIN(parser->chunk_size, (size_t) (end - p));
+        if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+          reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_CHUNK, (reactor_stream_data[]){{.base = p, .size = size}});
+        else if (parser->spill_fd >= 0)
+          {
+            if (reactor_http_parser_spill_write(parser, p, size) == -1)
+              {
+                reactor_http_parser_error(parser);
+                return;
+              }
+          }
+        else
+          {
+            if (data->base + parser->content_end != p)
+              memmove(data->base + parser->content_end, p, size);
+            parser->content_end += size;
+          }
+        p += size;
+        parser->chunk_size -= size;
+        if (!parser->chunk_size)
+          parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_DATA_CR;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_DATA_CR:
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_DATA_LF;
+        if (*p == '\r')
+          p ++;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_DATA_LF:
+        if (*p != '\n')
+          {
+            reactor_http_parser_reject(parser, 400);
+            return;
+          }
+        p ++;
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_SIZE_START;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_TRAILER:
+        if (*p == '\r' && end - p >= 2 && p[1] == '\n')
+          p ++;
+        if (*p == '\n')
+          {
+            p ++;
+            parser->state = REACTOR_HTTP_PARSER_FINAL;
+            break;
+          }
+        if (*p == '\r')
+          {
+            p = end;
+            break;
+          }
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_TRAILER_LINE;
+        break;
+      case REACTOR_HTTP_PARSER_CHUNK_TRAILER_LINE:
+        /* trailer fields count against the header limit as a whole */
+        eol = memchr(p, '\n', end - p);
+        parser->chunk_line += (eol ? eol + 1 : end) - p;
+        if (parser->header_max && parser->chunk_line > parser->header_max)
+          {
+            reactor_http_parser_reject(parser, 431);
+            return;
+          }
+        if (!eol)
+          {
+            p = end;
+            break;
+          }
+        p = eol + 1;
+        parser->chunk_state = REACTOR_HTTP_PARSER_CHUNK_TRAILER;
+        break;
+      }
+
+  if (parser->state == REACTOR_HTTP_PARSER_CLOSED)
     return;
-  size = strtoul(start, NULL, 16);
-  start = eol + 2;
-  if (size + 2 > (size_t) (end - start))
+
+  if (reactor_http_parser_spill_begin(parser, data, parser->content_end - parser->content_begin, p - data->base) == -1)
     return;
 
-  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM || parser->spill_fd >= 0)
     {
-      reactor_user_dispatch(&parser->user, REACTOR_HTTP_PARSER_CHUNK, (reactor_stream_data[]){{.base = start, .size = size}});
-      reactor_stream_data_consume(data, (start - data->base) + size + 2);
+      reactor_stream_data_consume(data, p - data->base);
+      parser->chunk_begin = 0;
+      parser->size = 0;
     }
   else
     {
-      memmove(data->base + parser->content_end, start, size);
-      parser->content_end += size;
-      parser->chunk_begin = (start - data->base) + size + 2;
-      parser->size = parser->content_end;
+      parser->chunk_begin = p - data->base;
+      parser->size = parser->chunk_begin;
     }
 
-  if (size == 0)
-    parser->state = REACTOR_HTTP_PARSER_FINAL;
-
-  reactor_http_parser_data(parser, data);
+  if (parser->state == REACTOR_HTTP_PARSER_FINAL)
+    reactor_http_parser_data(parser, data);
 }
 
 void reactor_http_parser_final(reactor_http_parser *parser, reactor_stream_data *data)
@@ -259,10 +706,27 @@ void reactor_http_parser_request_final(reactor_http_parser *parser, reactor_stre
   off_t offset;
 
   request = parser->request;
-  request->content = data->base + parser->content_begin;
-  request->content_size = parser->content_end - parser->content_begin;
-  offset = data->base - parser->base;
-  if (offset)
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+    {
+      /* the header of a streamed request was consumed at REQUEST_HEADER and is no longer in the input */
+      request->base = NULL;
+      request->method = NULL;
+      request->path = NULL;
+      request->content = NULL;
+      request->content_size = 0;
+      request->content_fd = -1;
+      vector_erase(&request->fields, 0, vector_size(&request->fields));
+      vector_erase(&request->ranges, 0, vector_size(&request->ranges));
+      memset(request->known, 0, REACTOR_HTTP_FIELD_MAX);
+      return;
+    }
+
+  request->base = parser->spill_fd >= 0 ? buffer_data(&parser->spill_header) : data->base;
+  request->content = parser->spill_fd >= 0 ? NULL : data->base + parser->content_begin;
+  request->content_size = parser->spill_fd >= 0 ? parser->spill_written : parser->content_end - parser->content_begin;
+  request->content_fd = parser->spill_fd;
+  offset = request->base - parser->base;
+  if (offset && (parser->flags & REACTOR_HTTP_PARSER_FLAGS_RANGES) == 0)
     {
       request->method += offset;
       request->path += offset;
@@ -276,10 +740,26 @@ void reactor_http_parser_response_final(reactor_http_parser *parser, reactor_str
   off_t offset;
 
   response = parser->response;
-  response->content = data->base + parser->content_begin;
-  response->content_size = parser->content_end - parser->content_begin;
-  offset = data->base - parser->base;
-  if (offset)
+  if (parser->flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+    {
+      /* the header of a streamed response was consumed with the HEADER event and is no longer in the input */
+      response->base = NULL;
+      response->message = NULL;
+      response->content = NULL;
+      response->content_size = 0;
+      response->content_fd = -1;
+      vector_erase(&response->fields, 0, vector_size(&response->fields));
+      vector_erase(&response->ranges, 0, vector_size(&response->ranges));
+      memset(response->known, 0, REACTOR_HTTP_FIELD_MAX);
+      return;
+    }
+
+  response->base = parser->spill_fd >= 0 ? buffer_data(&parser->spill_header) : data->base;
+  response->content = parser->spill_fd >= 0 ? NULL : data->base + parser->content_begin;
+  response->content_size = parser->spill_fd >= 0 ? parser->spill_written : parser->content_end - parser->content_begin;
+  response->content_fd = parser->spill_fd;
+  offset = response->base - parser->base;
+  if (offset && (parser->flags & REACTOR_HTTP_PARSER_FLAGS_RANGES) == 0)
     {
       response->message += offset;
       reactor_http_field_offset(&response->fields, offset);
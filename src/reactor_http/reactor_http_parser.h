@@ -5,13 +5,22 @@
 #define REACTOR_HTTP_PARSER_MAX_FIELDS 32
 #endif /* REACTOR_HTTP_PARSER_MAX_FIELDS */
 
+#ifndef REACTOR_HTTP_PARSER_HEADER_MAX
+#define REACTOR_HTTP_PARSER_HEADER_MAX 65536
+#endif /* REACTOR_HTTP_PARSER_HEADER_MAX */
+
+#ifndef REACTOR_HTTP_PARSER_URI_MAX
+#define REACTOR_HTTP_PARSER_URI_MAX 8192
+#endif /* REACTOR_HTTP_PARSER_URI_MAX */
+
 enum reactor_http_parser_events
 {
   REACTOR_HTTP_PARSER_ERROR,
   REACTOR_HTTP_PARSER_HEADER,
   REACTOR_HTTP_PARSER_CHUNK,
   REACTOR_HTTP_PARSER_CONTENT_END,
-  REACTOR_HTTP_PARSER_MESSAGE
+  REACTOR_HTTP_PARSER_MESSAGE,
+  REACTOR_HTTP_PARSER_EXPECT
 };
 
 enum reactor_http_parser_state
@@ -25,10 +34,27 @@ enum reactor_http_parser_state
   REACTOR_HTTP_PARSER_DONE
 };
 
+enum reactor_http_parser_chunk_state
+{
+  REACTOR_HTTP_PARSER_CHUNK_SIZE_START,
+  REACTOR_HTTP_PARSER_CHUNK_SIZE,
+  REACTOR_HTTP_PARSER_CHUNK_SIZE_END,
+  REACTOR_HTTP_PARSER_CHUNK_SIZE_LF,
+  REACTOR_HTTP_PARSER_CHUNK_EXTENSION,
+  REACTOR_HTTP_PARSER_CHUNK_DATA,
+  REACTOR_HTTP_PARSER_CHUNK_DATA_CR,
+  REACTOR_HTTP_PARSER_CHUNK_DATA_LF,
+  REACTOR_HTTP_PARSER_CHUNK_TRAILER,
+  REACTOR_HTTP_PARSER_CHUNK_TRAILER_LINE
+};
+
 enum reactor_http_parser_flags
 {
   REACTOR_HTTP_PARSER_FLAGS_RESPONSE = 0x01,
-  REACTOR_HTTP_PARSER_FLAGS_STREAM   = 0x02
+  REACTOR_HTTP_PARSER_FLAGS_STREAM   = 0x02,
+  REACTOR_HTTP_PARSER_FLAGS_RANGES   = 0x04,
+  REACTOR_HTTP_PARSER_FLAGS_HEADER   = 0x08,
+  REACTOR_HTTP_PARSER_FLAGS_HEAD     = 0x10
 };
 
 typedef struct reactor_http_parser reactor_http_parser;
@@ -41,16 +67,37 @@ struct reactor_http_parser
   reactor_http_response *response;
   char                  *base;
   size_t                 size;
+  size_t                 header_checked;
   size_t                 content_begin;
   size_t                 content_end;
   size_t                 chunk_begin;
+  int                    chunk_state;
+  size_t                 chunk_size;
+  size_t                 chunk_line;
+  size_t                 spill_size;
+  int                    spill_fd;
+  size_t                 spill_written;
+  buffer                 spill_header;
+  size_t                 header_max;
+  size_t                 fields_max;
+  size_t                 uri_max;
+  size_t                 body_max;
+  size_t                 body_size;
+  unsigned               status;
 };
 
 void reactor_http_parser_init(reactor_http_parser *, reactor_user_call *, void *);
 void reactor_http_parser_open_response(reactor_http_parser *, reactor_http_response *, int);
 void reactor_http_parser_open_request(reactor_http_parser *, reactor_http_request *, int);
 void reactor_http_parser_error(reactor_http_parser *);
+void reactor_http_parser_reject(reactor_http_parser *, unsigned);
+void reactor_http_parser_limits(reactor_http_parser *, size_t, size_t, size_t, size_t);
 void reactor_http_parser_close(reactor_http_parser *);
+void reactor_http_parser_spill(reactor_http_parser *, size_t);
+int  reactor_http_parser_spill_open(reactor_http_parser *, reactor_stream_data *);
+int  reactor_http_parser_spill_begin(reactor_http_parser *, reactor_stream_data *, size_t, size_t);
+int  reactor_http_parser_spill_write(reactor_http_parser *, char *, size_t);
+void reactor_http_parser_spill_close(reactor_http_parser *);
 void reactor_http_parser_data(reactor_http_parser *, reactor_stream_data *);
 void reactor_http_parser_request_header(reactor_http_parser *, reactor_stream_data *);
 void reactor_http_parser_response_header(reactor_http_parser *, reactor_stream_data *);
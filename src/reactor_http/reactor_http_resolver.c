@@ -0,0 +1,375 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+
+#include "reactor_http_resolver.h"
+
+void reactor_http_resolver_init(reactor_http_resolver *resolver)
+{
+  *resolver = (reactor_http_resolver) {.state = REACTOR_HTTP_RESOLVER_CLOSED, .call = reactor_http_resolver_getaddrinfo,
+                                       .ttl = REACTOR_HTTP_RESOLVER_TTL, .negative_ttl = REACTOR_HTTP_RESOLVER_NEGATIVE_TTL,
+                                       .max = REACTOR_HTTP_RESOLVER_CACHE_MAX};
+  vector_init(&resolver->cache, sizeof(reactor_http_resolver_entry));
+  reactor_stream_init(&resolver->stream, reactor_http_resolver_stream_event, resolver);
+}
+
+void reactor_http_resolver_function(reactor_http_resolver *resolver, reactor_http_resolver_call *call)
+{
+  resolver->call = call;
+}
+
+void reactor_http_resolver_ttl(reactor_http_resolver *resolver, time_t ttl, time_t negative_ttl)
+{
+  resolver->ttl = ttl;
+  resolver->negative_ttl = negative_ttl;
+}
+
+int reactor_http_resolver_open(reactor_http_resolver *resolver)
+{
+  reactor_http_resolver_shared *shared;
+  pthread_t thread;
+  int fd, e;
+
+  if (resolver->state != REACTOR_HTTP_RESOLVER_CLOSED)
+    return -1;
+
+  shared = malloc(sizeof *shared);
+  if (!shared)
+    return -1;
+  *shared = (reactor_http_resolver_shared) {.refs = 2, .call = resolver->call};
+
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd == -1)
+    {
+      free(shared);
+      return -1;
+    }
+
+  e = reactor_stream_open(&resolver->stream, fd);
+  if (e == -1)
+    {
+      (void) close(fd);
+      free(shared);
+      return -1;
+    }
+
+  shared->fd = fd;
+  (void) pthread_mutex_init(&shared->mutex, NULL);
+  (void) pthread_cond_init(&shared->cond, NULL);
+  e = pthread_create(&thread, NULL, reactor_http_resolver_thread, shared);
+  if (e != 0)
+    {
+      (void) pthread_cond_destroy(&shared->cond);
+      (void) pthread_mutex_destroy(&shared->mutex);
+      free(shared);
+      reactor_stream_close(&resolver->stream);
+      return -1;
+    }
+  (void) pthread_detach(thread);
+
+  resolver->shared = shared;
+  resolver->state = REACTOR_HTTP_RESOLVER_OPEN;
+  return 0;
+}
+
+void reactor_http_resolver_close(reactor_http_resolver *resolver)
+{
+  reactor_http_resolver_shared *shared;
+  reactor_http_resolver_queue pending, done;
+
+  if (resolver->state != REACTOR_HTTP_RESOLVER_OPEN)
+    return;
+
+  /* does not wait for a lookup in progress, the thread drops its result and frees the shared state when it returns */
+  shared = resolver->shared;
+  (void) pthread_mutex_lock(&shared->mutex);
+  shared->stop = 1;
+  pending = shared->pending;
+  done = shared->done;
+  shared->pending = (reactor_http_resolver_queue) {0};
+  shared->done = (reactor_http_resolver_queue) {0};
+  (void) pthread_cond_signal(&shared->cond);
+  (void) pthread_mutex_unlock(&shared->mutex);
+  reactor_http_resolver_release(shared);
+  resolver->shared = NULL;
+
+  reactor_http_resolver_free(&pending);
+  reactor_http_resolver_free(&done);
+  reactor_http_resolver_free(&resolver->delivered);
+  reactor_stream_close(&resolver->stream);
+  reactor_http_resolver_cache_clear(resolver);
+  resolver->state = REACTOR_HTTP_RESOLVER_CLOSED;
+}
+
+int reactor_http_resolver_lookup(reactor_http_resolver *resolver, char *host, reactor_http_resolver_result *result,
+                                 reactor_user_call *call, void *state)
+{
+  reactor_http_resolver_entry *entry;
+  reactor_http_resolver_query *query;
+
+  entry = reactor_http_resolver_cache_lookup(resolver, host, time(NULL));
+  if (entry)
+    {
+      resolver->hits ++;
+      *result = (reactor_http_resolver_result) {.host = host, .error = entry->error};
+      memcpy(result->address, entry->address, sizeof result->address);
+      return 1;
+    }
+
+  if (resolver->state != REACTOR_HTTP_RESOLVER_OPEN)
+    return -1;
+
+  query = malloc(sizeof *query);
+  if (!query)
+    return -1;
+  *query = (reactor_http_resolver_query) {.result.host = strdup(host)};
+  if (!query->result.host)
+    {
+      free(query);
+      return -1;
+    }
+  reactor_user_init(&query->user, call, state);
+
+  resolver->misses ++;
+  (void) pthread_mutex_lock(&resolver->shared->mutex);
+  reactor_http_resolver_push(&resolver->shared->pending, query);
+  (void) pthread_cond_signal(&resolver->shared->cond);
+  (void) pthread_mutex_unlock(&resolver->shared->mutex);
+  return 0;
+}
+
+void reactor_http_resolver_cancel(reactor_http_resolver *resolver, reactor_user_call *call, void *state)
+{
+  reactor_http_resolver_shared *shared;
+  reactor_http_resolver_query *query;
+
+  if (resolver->state != REACTOR_HTTP_RESOLVER_OPEN)
+    return;
+
+  /* cancelled queries still complete and fill the cache, they are just not dispatched */
+  shared = resolver->shared;
+  (void) pthread_mutex_lock(&shared->mutex);
+  for (query = shared->pending.head; query; query = query->next)
+    if (query->user.call == call && query->user.state == state)
+      query->cancelled = 1;
+  if (shared->current && shared->current->user.call == call && shared->current->user.state == state)
+    shared->current->cancelled = 1;
+  for (query = shared->done.head; query; query = query->next)
+    if (query->user.call == call && query->user.state == state)
+      query->cancelled = 1;
+  (void) pthread_mutex_unlock(&shared->mutex);
+
+  for (query = resolver->delivered.head; query; query = query->next)
+    if (query->user.call == call && query->user.state == state)
+      query->cancelled = 1;
+}
+
+int reactor_http_resolver_getaddrinfo(char *host, char *address, size_t size)
+{
+  struct addrinfo *ai, hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_ADDRCONFIG};
+  int e;
+
+  e = getaddrinfo(host, NULL, &hints, &ai);
+  if (e != 0)
+    return e;
+
+  e = getnameinfo(ai->ai_addr, ai->ai_addrlen, address, size, NULL, 0, NI_NUMERICHOST);
+  freeaddrinfo(ai);
+  return e;
+}
+
+reactor_http_resolver_entry *reactor_http_resolver_cache_lookup(reactor_http_resolver *resolver, char *host, time_t now)
+{
+  reactor_http_resolver_entry *entry;
+  size_t i;
+
+  for (i = 0; i < vector_size(&resolver->cache); i ++)
+    {
+      entry = vector_at(&resolver->cache, i);
+      if (strcmp(entry->host, host) == 0)
+        {
+          if (entry->expires > now)
+            return entry;
+          free(entry->host);
+          vector_erase(&resolver->cache, i, i + 1);
+          return NULL;
+        }
+    }
+
+  return NULL;
+}
+
+void reactor_http_resolver_cache_store(reactor_http_resolver *resolver, reactor_http_resolver_result *result, time_t now)
+{
+  reactor_http_resolver_entry entry, *existing;
+  time_t ttl;
+  int e;
+
+  ttl = result->error ? resolver->negative_ttl : resolver->ttl;
+  if (ttl <= 0 || !resolver->max)
+    return;
+
+  existing = reactor_http_resolver_cache_lookup(resolver, result->host, now);
+  if (existing)
+    {
+      existing->expires = now + ttl;
+      existing->error = result->error;
+      memcpy(existing->address, result->address, sizeof existing->address);
+      return;
+    }
+
+  entry = (reactor_http_resolver_entry) {.host = strdup(result->host), .expires = now + ttl, .error = result->error};
+  if (!entry.host)
+    return;
+  memcpy(entry.address, result->address, sizeof entry.address);
+
+  /* the oldest entry is replaced when the cache is full */
+  if (vector_size(&resolver->cache) >= resolver->max)
+    {
+      free(((reactor_http_resolver_entry *) vector_front(&resolver->cache))->host);
+      vector_erase(&resolver->cache, 0, 1);
+    }
+
+  e = vector_push_back(&resolver->cache, &entry);
+  if (e == -1)
+    free(entry.host);
+}
+
+void reactor_http_resolver_cache_clear(reactor_http_resolver *resolver)
+{
+  size_t i;
+
+  for (i = 0; i < vector_size(&resolver->cache); i ++)
+    free(((reactor_http_resolver_entry *) vector_at(&resolver->cache, i))->host);
+  vector_clear(&resolver->cache);
+}
+
+void reactor_http_resolver_push(reactor_http_resolver_queue *queue, reactor_http_resolver_query *query)
+{
+  query->next = NULL;
+  if (queue->tail)
+    queue->tail->next = query;
+  else
+    queue->head = query;
+  queue->tail = query;
+}
+
+reactor_http_resolver_query *reactor_http_resolver_pop(reactor_http_resolver_queue *queue)
+{
+  reactor_http_resolver_query *query;
+
+  query = queue->head;
+  if (query)
+    {
+      queue->head = query->next;
+      if (!queue->head)
+        queue->tail = NULL;
+    }
+  return query;
+}
+
+void reactor_http_resolver_free(reactor_http_resolver_queue *queue)
+{
+  reactor_http_resolver_query *query;
+
+  while ((query = reactor_http_resolver_pop(queue)))
+    {
+      free(query->result.host);
+      free(query);
+    }
+}
+
+void reactor_http_resolver_release(reactor_http_resolver_shared *shared)
+{
+  size_t refs;
+
+  (void) pthread_mutex_lock(&shared->mutex);
+  refs = -- shared->refs;
+  (void) pthread_mutex_unlock(&shared->mutex);
+  if (refs)
+    return;
+
+  (void) pthread_cond_destroy(&shared->cond);
+  (void) pthread_mutex_destroy(&shared->mutex);
+  free(shared);
+}
+
+void *reactor_http_resolver_thread(void *arg)
+{
+  reactor_http_resolver_shared *shared;
+  reactor_http_resolver_query *query;
+  uint64_t one = 1;
+  ssize_t n;
+
+  shared = arg;
+  (void) pthread_mutex_lock(&shared->mutex);
+  while (1)
+    {
+      while (!shared->stop && !shared->pending.head)
+        (void) pthread_cond_wait(&shared->cond, &shared->mutex);
+      if (shared->stop)
+        break;
+
+      query = reactor_http_resolver_pop(&shared->pending);
+      shared->current = query;
+      (void) pthread_mutex_unlock(&shared->mutex);
+
+      query->result.error = shared->call(query->result.host, query->result.address, sizeof query->result.address);
+
+      /* the eventfd is closed with the resolver, so it is only written while the resolver is open */
+      (void) pthread_mutex_lock(&shared->mutex);
+      shared->current = NULL;
+      if (shared->stop)
+        {
+          free(query->result.host);
+          free(query);
+          break;
+        }
+      reactor_http_resolver_push(&shared->done, query);
+      n = write(shared->fd, &one, sizeof one);
+      (void) n;
+    }
+  (void) pthread_mutex_unlock(&shared->mutex);
+  reactor_http_resolver_release(shared);
+  return NULL;
+}
+
+void reactor_http_resolver_stream_event(void *state, int type, void *data)
+{
+  reactor_http_resolver *resolver;
+  reactor_http_resolver_query *query;
+  time_t now;
+
+  resolver = state;
+  if (type != REACTOR_STREAM_DATA)
+    return;
+
+  reactor_stream_data_consume(data, ((reactor_stream_data *) data)->size);
+  (void) pthread_mutex_lock(&resolver->shared->mutex);
+  resolver->delivered = resolver->shared->done;
+  resolver->shared->done = (reactor_http_resolver_queue) {0};
+  (void) pthread_mutex_unlock(&resolver->shared->mutex);
+
+  now = time(NULL);
+  while (resolver->state == REACTOR_HTTP_RESOLVER_OPEN && (query = reactor_http_resolver_pop(&resolver->delivered)))
+    {
+      reactor_http_resolver_cache_store(resolver, &query->result, now);
+      if (!query->cancelled)
+        reactor_user_dispatch(&query->user, query->result.error ? REACTOR_HTTP_RESOLVER_ERROR : REACTOR_HTTP_RESOLVER_RESULT,
+                              &query->result);
+      free(query->result.host);
+      free(query);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef REACTOR_HTTP_RESOLVER_H_INCLUDED
+#define REACTOR_HTTP_RESOLVER_H_INCLUDED
+
+#define REACTOR_HTTP_RESOLVER_ADDRESS_SIZE 64
+
+#ifndef REACTOR_HTTP_RESOLVER_TTL
+#define REACTOR_HTTP_RESOLVER_TTL 60
+#endif /* REACTOR_HTTP_RESOLVER_TTL */
+
+#ifndef REACTOR_HTTP_RESOLVER_NEGATIVE_TTL
+#define REACTOR_HTTP_RESOLVER_NEGATIVE_TTL 5
+#endif /* REACTOR_HTTP_RESOLVER_NEGATIVE_TTL */
+
+#ifndef REACTOR_HTTP_RESOLVER_CACHE_MAX
+#define REACTOR_HTTP_RESOLVER_CACHE_MAX 256
+#endif /* REACTOR_HTTP_RESOLVER_CACHE_MAX */
+
+enum reactor_http_resolver_event
+{
+  REACTOR_HTTP_RESOLVER_ERROR,
+  REACTOR_HTTP_RESOLVER_RESULT
+};
+
+enum reactor_http_resolver_state
+{
+  REACTOR_HTTP_RESOLVER_CLOSED,
+  REACTOR_HTTP_RESOLVER_OPEN
+};
+
+typedef int reactor_http_resolver_call(char *, char *, size_t);
+
+typedef struct reactor_http_resolver_result reactor_http_resolver_result;
+struct reactor_http_resolver_result
+{
+  char                  *host;
+  int                    error;
+  char                   address[REACTOR_HTTP_RESOLVER_ADDRESS_SIZE];
+};
+
+typedef struct reactor_http_resolver_entry reactor_http_resolver_entry;
+struct reactor_http_resolver_entry
+{
+  char                  *host;
+  time_t                 expires;
+  int                    error;
+  char                   address[REACTOR_HTTP_RESOLVER_ADDRESS_SIZE];
+};
+
+typedef struct reactor_http_resolver_query reactor_http_resolver_query;
+struct reactor_http_resolver_query
+{
+  reactor_http_resolver_query *next;
+  reactor_user           user;
+  int                    cancelled;
+  reactor_http_resolver_result result;
+};
+
+typedef struct reactor_http_resolver_queue reactor_http_resolver_queue;
+struct reactor_http_resolver_queue
+{
+  reactor_http_resolver_query *head;
+  reactor_http_resolver_query *tail;
+};
+
+typedef struct reactor_http_resolver_shared reactor_http_resolver_shared;
+struct reactor_http_resolver_shared
+{
+  pthread_mutex_t        mutex;
+  pthread_cond_t         cond;
+  size_t                 refs;
+  int                    stop;
+  int                    fd;
+  reactor_http_resolver_call *call;
+  reactor_http_resolver_query *current;
+  reactor_http_resolver_queue pending;
+  reactor_http_resolver_queue done;
+};
+
+typedef struct reactor_http_resolver reactor_http_resolver;
+struct reactor_http_resolver
+{
+  int                    state;
+  reactor_http_resolver_call *call;
+  time_t                 ttl;
+  time_t                 negative_ttl;
+  size_t                 max;
+  vector                 cache;
+  size_t                 hits;
+  size_t                 misses;
+  reactor_stream         stream;
+  reactor_http_resolver_shared *shared;
+  reactor_http_resolver_queue delivered;
+};
+
+void  reactor_http_resolver_init(reactor_http_resolver *);
+void  reactor_http_resolver_function(reactor_http_resolver *, reactor_http_resolver_call *);
+void  reactor_http_resolver_ttl(reactor_http_resolver *, time_t, time_t);
+int   reactor_http_resolver_open(reactor_http_resolver *);
+void  reactor_http_resolver_close(reactor_http_resolver *);
+int   reactor_http_resolver_lookup(reactor_http_resolver *, char *, reactor_http_resolver_result *, reactor_user_call *, void *);
+void  reactor_http_resolver_cancel(reactor_http_resolver *, reactor_user_call *, void *);
+int   reactor_http_resolver_getaddrinfo(char *, char *, size_t);
+reactor_http_resolver_entry *reactor_http_resolver_cache_lookup(reactor_http_resolver *, char *, time_t);
+void  reactor_http_resolver_cache_store(reactor_http_resolver *, reactor_http_resolver_result *, time_t);
+void  reactor_http_resolver_cache_clear(reactor_http_resolver *);
+void  reactor_http_resolver_push(reactor_http_resolver_queue *, reactor_http_resolver_query *);
+reactor_http_resolver_query *reactor_http_resolver_pop(reactor_http_resolver_queue *);
+void  reactor_http_resolver_free(reactor_http_resolver_queue *);
+void  reactor_http_resolver_release(reactor_http_resolver_shared *);
+void *reactor_http_resolver_thread(void *);
+void  reactor_http_resolver_stream_event(void *, int, void *);
+
+#endif /* REACTOR_HTTP_RESOLVER_H_INCLUDED */
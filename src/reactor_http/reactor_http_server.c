@@ -5,9 +5,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <netdb.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <sys/param.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 
 #include <dynamic.h>
 #include <clo.h>
@@ -19,6 +23,25 @@
 #include "reactor_http_parser.h"
 #include "reactor_http_server.h"
 
+typedef struct reactor_http_server_reject reactor_http_server_reject;
+struct reactor_http_server_reject
+{
+  unsigned               status;
+  char                  *data;
+};
+
+static const reactor_http_server_reject reactor_http_server_rejects[] =
+  {
+    {400, "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\nDate: "},
+    {413, "HTTP/1.1 413 Payload Too Large\r\nConnection: close\r\nContent-Length: 0\r\nDate: "},
+    {414, "HTTP/1.1 414 URI Too Long\r\nConnection: close\r\nContent-Length: 0\r\nDate: "},
+    {417, "HTTP/1.1 417 Expectation Failed\r\nConnection: close\r\nContent-Length: 0\r\nDate: "},
+    {431, "HTTP/1.1 431 Request Header Fields Too Large\r\nConnection: close\r\nContent-Length: 0\r\nDate: "}
+  };
+
+static const unsigned reactor_http_server_prefix_status[REACTOR_HTTP_SERVER_PREFIX_MAX] =
+  {200, 204, 304, 404, 201, 206, 301, 302, 400, 401, 403, 405, 500, 503};
+
 void reactor_http_server_init(reactor_http_server *server, reactor_user_call *call, void *state)
 {
   server->state = 0;
@@ -26,6 +49,13 @@ void reactor_http_server_init(reactor_http_server *server, reactor_user_call *ca
   reactor_user_init(&server->user, call, state);
   reactor_tcp_server_init(&server->tcp_server, reactor_http_server_tcp_event, server);
   reactor_timer_init(&server->date_timer, reactor_http_server_date_event, server);
+  reactor_http_server_pool_init(&server->pool);
+  reactor_http_server_buffers_init(&server->buffers);
+  reactor_http_server_reclaim(server, REACTOR_HTTP_SERVER_RECLAIM_TIMEOUT);
+  reactor_http_server_limits(server, REACTOR_HTTP_PARSER_HEADER_MAX, REACTOR_HTTP_PARSER_MAX_FIELDS,
+                             REACTOR_HTTP_PARSER_URI_MAX, 0);
+  reactor_http_server_timeouts(server, REACTOR_HTTP_SERVER_HEADER_TIMEOUT, REACTOR_HTTP_SERVER_BODY_TIMEOUT,
+                               REACTOR_HTTP_SERVER_IDLE_TIMEOUT, REACTOR_HTTP_SERVER_WRITE_TIMEOUT);
 }
 
 int reactor_http_server_open(reactor_http_server *server, char *node, char *service)
@@ -33,6 +63,10 @@ int reactor_http_server_open(reactor_http_server *server, char *node, char *serv
   int e;
 
   reactor_http_server_date_update(server);
+  e = reactor_http_server_pool_prewarm(server);
+  if (e == -1)
+    return -1;
+
   e = reactor_timer_open(&server->date_timer, 1000000000, 1000000000);
   if (e == -1)
     return -1;
@@ -48,6 +82,49 @@ int reactor_http_server_open(reactor_http_server *server, char *node, char *serv
 void reactor_http_server_name(reactor_http_server *server, char *name)
 {
   server->name = name;
+  reactor_http_server_prefix_update(server);
+}
+
+void reactor_http_server_flags(reactor_http_server *server, int flags)
+{
+  server->flags = flags;
+}
+
+void reactor_http_server_spill(reactor_http_server *server, size_t size)
+{
+  server->spill = size;
+}
+
+void reactor_http_server_pool_size(reactor_http_server *server, size_t prewarm, size_t max)
+{
+  server->pool.prewarm = prewarm;
+  server->pool.max = max;
+}
+
+void reactor_http_server_timeouts(reactor_http_server *server, unsigned header, unsigned body, unsigned idle, unsigned write)
+{
+  server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_HEADER] = header;
+  server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_BODY] = body;
+  server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_IDLE] = idle;
+  server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_WRITE] = write;
+}
+
+void reactor_http_server_reclaim(reactor_http_server *server, unsigned timeout)
+{
+  server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM] = timeout;
+}
+
+void reactor_http_server_limits(reactor_http_server *server, size_t header, size_t fields, size_t uri, size_t body)
+{
+  server->header_max = header;
+  server->fields_max = fields;
+  server->uri_max = uri;
+  server->body_max = body;
+}
+
+void reactor_http_server_requests_max(reactor_http_server *server, size_t max)
+{
+  server->requests_max = max;
 }
 
 void reactor_http_server_error(reactor_http_server *server)
@@ -73,10 +150,25 @@ void reactor_http_server_close(reactor_http_server *server)
       server->date_timer.state == REACTOR_TIMER_CLOSED)
     {
       server->state = REACTOR_HTTP_SERVER_CLOSED;
+      reactor_http_server_pool_clear(&server->pool);
+      reactor_http_server_buffers_clear(&server->buffers);
       reactor_user_dispatch(&server->user, REACTOR_HTTP_SERVER_CLOSE, NULL);
     }
 }
 
+void reactor_http_server_shutdown(reactor_http_server *server)
+{
+  reactor_http_server_session *session, *next;
+
+  /* unlike a plain close, connections still open are closed as well */
+  reactor_http_server_close(server);
+  for (session = server->sessions; session; session = next)
+    {
+      next = session->active_next;
+      reactor_http_server_session_close(session);
+    }
+}
+
 void reactor_http_server_tcp_event(void *state, int type, void *data)
 {
   reactor_http_server *server;
@@ -89,22 +181,23 @@ void reactor_http_server_tcp_event(void *state, int type, void *data)
     {
     case REACTOR_TCP_SERVER_ACCEPT:
       client = data;
-      session = malloc(sizeof *session);
+      session = reactor_http_server_pool_get(server);
       if (!session)
         {
+          (void) close(client->fd);
           reactor_http_server_error(server);
           break;
         }
 
-      reactor_http_server_session_init(session, server);
       e = reactor_http_server_session_open(session, client->fd);
       if (e == -1)
         {
           (void) close(client->fd);
-          free(session);
+          reactor_http_server_pool_put(server, session);
           break;
         }
 
+      reactor_http_server_session_link(session);
       reactor_user_dispatch(&server->user, REACTOR_HTTP_SERVER_ACCEPT, session);
       break;
     case REACTOR_TCP_SERVER_CLOSE:
@@ -123,23 +216,285 @@ void reactor_http_server_date_event(void *state, int type, void *data)
   (void) data;
   server = state;
   if (type == REACTOR_TIMER_TIMEOUT)
-    reactor_http_server_date_update(server);
+    {
+      reactor_http_server_date_update(server);
+      reactor_http_server_wheel_tick(server);
+    }
   else if (type == REACTOR_TIMER_CLOSE)
     reactor_http_server_close(server);
 }
 
 void reactor_http_server_date_update(reactor_http_server *server)
 {
-  static const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
-  static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
-  time_t t;
-  struct tm tm;
+  reactor_http_date(server->date, time(NULL));
+  reactor_http_server_prefix_update(server);
+}
+
+void reactor_http_server_prefix_update(reactor_http_server *server)
+{
+  reactor_http_server_prefix *prefix;
+  size_t i;
+  int n;
+
+  for (i = 0; i < REACTOR_HTTP_SERVER_PREFIX_MAX; i ++)
+    {
+      prefix = &server->prefix[i];
+      prefix->status = reactor_http_server_prefix_status[i];
+      if (server->name)
+        n = snprintf(prefix->data, sizeof prefix->data, "HTTP/1.1 %u %s\r\nServer: %s\r\nDate: %s\r\n",
+                     prefix->status, reactor_http_status_message(prefix->status), server->name, server->date);
+      else
+        n = snprintf(prefix->data, sizeof prefix->data, "HTTP/1.1 %u %s\r\nDate: %s\r\n",
+                     prefix->status, reactor_http_status_message(prefix->status), server->date);
+      prefix->size = n > 0 && (size_t) n < sizeof prefix->data ? (size_t) n : 0;
+    }
+}
+
+reactor_http_server_prefix *reactor_http_server_prefix_lookup(reactor_http_server *server, unsigned status)
+{
+  size_t i;
+
+  for (i = 0; i < REACTOR_HTTP_SERVER_PREFIX_MAX; i ++)
+    if (server->prefix[i].status == status)
+      return server->prefix[i].size ? &server->prefix[i] : NULL;
+  return NULL;
+}
+
+void reactor_http_server_wheel_arm(reactor_http_server *server, reactor_http_server_session *session, unsigned timeout)
+{
+  reactor_http_server_wheel_cancel(server, session);
+  if (!timeout)
+    return;
+
+  session->deadline = server->wheel.now + timeout;
+  reactor_http_server_wheel_insert(server, session);
+}
+
+void reactor_http_server_wheel_insert(reactor_http_server *server, reactor_http_server_session *session)
+{
+  reactor_http_server_session **slot;
+  uint64_t lap;
+
+  /* deadlines within a lap go in a one second slot, later ones in the slot of their lap and are cascaded down
+   * when it starts, deadlines beyond the last lap wait in it and are placed again from there */
+  if (session->deadline - server->wheel.now < REACTOR_HTTP_SERVER_WHEEL_SIZE)
+    slot = &server->wheel.slots[session->deadline % REACTOR_HTTP_SERVER_WHEEL_SIZE];
+  else
+    {
+      lap = session->deadline / REACTOR_HTTP_SERVER_WHEEL_SIZE;
+      if (lap - server->wheel.now / REACTOR_HTTP_SERVER_WHEEL_SIZE >= REACTOR_HTTP_SERVER_WHEEL_SIZE)
+        lap = server->wheel.now / REACTOR_HTTP_SERVER_WHEEL_SIZE + REACTOR_HTTP_SERVER_WHEEL_SIZE - 1;
+      slot = &server->wheel.laps[lap % REACTOR_HTTP_SERVER_WHEEL_SIZE];
+    }
+
+  session->wheel_slot = slot;
+  session->wheel_prev = NULL;
+  session->wheel_next = *slot;
+  if (*slot)
+    (*slot)->wheel_prev = session;
+  *slot = session;
+}
+
+void reactor_http_server_wheel_cancel(reactor_http_server *server, reactor_http_server_session *session)
+{
+  (void) server;
+  if (!session->deadline)
+    return;
+
+  if (session->wheel_prev)
+    session->wheel_prev->wheel_next = session->wheel_next;
+  else
+    *session->wheel_slot = session->wheel_next;
+  if (session->wheel_next)
+    session->wheel_next->wheel_prev = session->wheel_prev;
+  session->deadline = 0;
+}
+
+void reactor_http_server_wheel_tick(reactor_http_server *server)
+{
+  reactor_http_server_session *session, *next;
+
+  server->wheel.now ++;
+  if (server->wheel.now % REACTOR_HTTP_SERVER_WHEEL_SIZE == 0)
+    {
+      session = server->wheel.laps[(server->wheel.now / REACTOR_HTTP_SERVER_WHEEL_SIZE) % REACTOR_HTTP_SERVER_WHEEL_SIZE];
+      server->wheel.laps[(server->wheel.now / REACTOR_HTTP_SERVER_WHEEL_SIZE) % REACTOR_HTTP_SERVER_WHEEL_SIZE] = NULL;
+      for (; session; session = next)
+        {
+          next = session->wheel_next;
+          reactor_http_server_wheel_insert(server, session);
+        }
+    }
+
+  for (session = server->wheel.slots[server->wheel.now % REACTOR_HTTP_SERVER_WHEEL_SIZE]; session; session = next)
+    {
+      next = session->wheel_next;
+      reactor_http_server_wheel_cancel(server, session);
+      if (session->timeout == REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM)
+        {
+          /* the remainder of the idle timeout runs with the buffers returned to the server */
+          reactor_http_server_session_reclaim(session);
+          session->timeout = REACTOR_HTTP_SERVER_TIMEOUT_IDLE;
+          if (server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_IDLE])
+            reactor_http_server_wheel_arm(server, session, server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_IDLE] -
+                                          server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM]);
+        }
+      else
+        reactor_http_server_session_close(session);
+    }
+}
+
+void reactor_http_server_buffers_init(reactor_http_server_buffers *buffers)
+{
+  size_t i;
+
+  *buffers = (reactor_http_server_buffers) {.max = REACTOR_HTTP_SERVER_BUFFERS_MAX};
+  for (i = 0; i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES; i ++)
+    vector_init(&buffers->classes[i], sizeof(buffer));
+}
+
+void reactor_http_server_buffers_get(reactor_http_server_buffers *buffers, buffer *b, size_t size)
+{
+  size_t i;
 
-  (void) time(&t);
-  (void) gmtime_r(&t, &tm);
-  (void) strftime(server->date, sizeof server->date, "---, %d --- %Y %H:%M:%S GMT", &tm);
-  memcpy(server->date, days[tm.tm_wday], 3);
-  memcpy(server->date + 8, months[tm.tm_mon], 3);
+  if (buffer_capacity(b) || !size)
+    return;
+
+  /* start from the smallest class that holds the expected size, a smaller buffer would be grown again right away */
+  for (i = 0; i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES && size > (size_t) REACTOR_HTTP_SERVER_BUFFERS_MIN << i; i ++);
+  for (; i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES; i ++)
+    if (vector_size(&buffers->classes[i]))
+      {
+        *b = *(buffer *) vector_back(&buffers->classes[i]);
+        vector_pop_back(&buffers->classes[i]);
+        buffers->hits ++;
+        return;
+      }
+  buffers->misses ++;
+}
+
+void reactor_http_server_buffers_put(reactor_http_server_buffers *buffers, buffer *b)
+{
+  size_t i;
+  int e;
+
+  if (!buffer_capacity(b))
+    return;
+
+  /* class i holds capacities up to REACTOR_HTTP_SERVER_BUFFERS_MIN << i, larger buffers are freed */
+  for (i = 0; i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES && buffer_capacity(b) > (size_t) REACTOR_HTTP_SERVER_BUFFERS_MIN << i; i ++);
+  if (i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES && vector_size(&buffers->classes[i]) < buffers->max)
+    {
+      buffer_erase(b, 0, buffer_size(b));
+      e = vector_push_back(&buffers->classes[i], b);
+      if (e == 0)
+        {
+          buffer_init(b);
+          return;
+        }
+    }
+  buffer_clear(b);
+}
+
+void reactor_http_server_buffers_clear(reactor_http_server_buffers *buffers)
+{
+  size_t i, j;
+
+  for (i = 0; i < REACTOR_HTTP_SERVER_BUFFERS_CLASSES; i ++)
+    {
+      for (j = 0; j < vector_size(&buffers->classes[i]); j ++)
+        buffer_clear(vector_at(&buffers->classes[i], j));
+      vector_clear(&buffers->classes[i]);
+    }
+}
+
+void reactor_http_server_pool_init(reactor_http_server_pool *pool)
+{
+  *pool = (reactor_http_server_pool) {.max = REACTOR_HTTP_SERVER_POOL_MAX};
+  vector_init(&pool->sessions, sizeof(reactor_http_server_session *));
+}
+
+int reactor_http_server_pool_prewarm(reactor_http_server *server)
+{
+  reactor_http_server_pool *pool;
+  reactor_http_server_session *session;
+  int e;
+
+  pool = &server->pool;
+  e = vector_reserve(&pool->sessions, MIN(pool->prewarm, pool->max));
+  if (e == -1)
+    return -1;
+
+  while (vector_size(&pool->sessions) < MIN(pool->prewarm, pool->max))
+    {
+      session = malloc(sizeof *session);
+      if (!session)
+        return -1;
+
+      reactor_http_server_session_init(session, server);
+      e = vector_push_back(&pool->sessions, &session);
+      if (e == -1)
+        {
+          reactor_http_server_session_free(session);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+reactor_http_server_session *reactor_http_server_pool_get(reactor_http_server *server)
+{
+  reactor_http_server_pool *pool;
+  reactor_http_server_session *session;
+
+  pool = &server->pool;
+  if (vector_size(&pool->sessions))
+    {
+      session = *(reactor_http_server_session **) vector_back(&pool->sessions);
+      vector_pop_back(&pool->sessions);
+      reactor_http_server_session_reset(session);
+      pool->hits ++;
+    }
+  else
+    {
+      session = malloc(sizeof *session);
+      if (!session)
+        return NULL;
+      reactor_http_server_session_init(session, server);
+      pool->misses ++;
+    }
+
+  pool->used ++;
+  if (pool->used > pool->high_water)
+    pool->high_water = pool->used;
+  return session;
+}
+
+void reactor_http_server_pool_put(reactor_http_server *server, reactor_http_server_session *session)
+{
+  reactor_http_server_pool *pool;
+  int e;
+
+  pool = &server->pool;
+  pool->used --;
+  if (server->state == REACTOR_HTTP_SERVER_LISTENING && vector_size(&pool->sessions) < pool->max)
+    {
+      e = vector_push_back(&pool->sessions, &session);
+      if (e == 0)
+        return;
+    }
+
+  reactor_http_server_session_free(session);
+}
+
+void reactor_http_server_pool_clear(reactor_http_server_pool *pool)
+{
+  size_t i;
+
+  for (i = 0; i < vector_size(&pool->sessions); i ++)
+    reactor_http_server_session_free(*(reactor_http_server_session **) vector_at(&pool->sessions, i));
+  vector_clear(&pool->sessions);
 }
 
 void reactor_http_server_session_init(reactor_http_server_session *session, reactor_http_server *server)
@@ -148,21 +503,249 @@ void reactor_http_server_session_init(reactor_http_server_session *session, reac
   reactor_stream_init(&session->stream, reactor_http_server_session_stream_event, session);
   reactor_http_parser_init(&session->parser, reactor_http_server_session_parser_event, session);
   reactor_http_request_init(&session->request);
+  buffer_init(&session->header);
+  vector_init(&session->segments, sizeof(reactor_http_server_segment));
+  buffer_init(&session->deferred);
+  buffer_init(&session->chunk);
+  vector_init(&session->batch, sizeof(reactor_http_request));
+  vector_init(&session->messages, sizeof(reactor_http_server_message));
+}
+
+void reactor_http_server_session_reset(reactor_http_server_session *session)
+{
+  buffer input, output, header, deferred, chunk;
+  vector fields, ranges, segments, batch, messages;
+
+  input = session->stream.input;
+  output = session->stream.output;
+  header = session->header;
+  deferred = session->deferred;
+  chunk = session->chunk;
+  segments = session->segments;
+  batch = session->batch;
+  messages = session->messages;
+  fields = session->request.fields;
+  ranges = session->request.ranges;
+  reactor_http_server_session_init(session, session->server);
+
+  /* keep the storage of the previous connection, only the contents are discarded */
+  session->stream.input = input;
+  session->stream.output = output;
+  buffer_erase(&session->stream.input, 0, buffer_size(&session->stream.input));
+  buffer_erase(&session->stream.output, 0, buffer_size(&session->stream.output));
+  session->header = header;
+  session->deferred = deferred;
+  buffer_erase(&session->deferred, 0, buffer_size(&session->deferred));
+  session->chunk = chunk;
+  buffer_erase(&session->chunk, 0, buffer_size(&session->chunk));
+  session->segments = segments;
+  vector_erase(&session->segments, 0, vector_size(&session->segments));
+  session->batch = batch;
+  session->messages = messages;
+  vector_erase(&session->messages, 0, vector_size(&session->messages));
+  session->request.fields = fields;
+  vector_erase(&session->request.fields, 0, vector_size(&session->request.fields));
+  session->request.ranges = ranges;
+  vector_erase(&session->request.ranges, 0, vector_size(&session->request.ranges));
+}
+
+void reactor_http_server_session_free(reactor_http_server_session *session)
+{
+  size_t i;
+
+  reactor_http_parser_close(&session->parser);
+  reactor_http_request_clear(&session->request);
+  buffer_clear(&session->stream.input);
+  buffer_clear(&session->stream.output);
+  buffer_clear(&session->header);
+  buffer_clear(&session->deferred);
+  buffer_clear(&session->chunk);
+  vector_clear(&session->segments);
+  for (i = 0; i < vector_size(&session->batch); i ++)
+    reactor_http_request_clear(vector_at(&session->batch, i));
+  vector_clear(&session->batch);
+  vector_clear(&session->messages);
+  free(session);
 }
 
 int reactor_http_server_session_open(reactor_http_server_session *session, int fd)
 {
-  reactor_http_parser_open_request(&session->parser, &session->request, 0);
-  return reactor_stream_open(&session->stream, fd);
+  int flags, e;
+
+  flags = session->server->flags & REACTOR_HTTP_SERVER_FLAGS_RANGES ? REACTOR_HTTP_PARSER_FLAGS_RANGES : 0;
+  if (session->server->flags & REACTOR_HTTP_SERVER_FLAGS_STREAM)
+    flags |= REACTOR_HTTP_PARSER_FLAGS_HEADER;
+  reactor_http_parser_open_request(&session->parser, &session->request, flags);
+  reactor_http_parser_spill(&session->parser, session->server->spill);
+  reactor_http_parser_limits(&session->parser, session->server->header_max, session->server->fields_max,
+                             session->server->uri_max, session->server->body_max);
+  e = reactor_stream_open(&session->stream, fd);
+  if (e == -1)
+    return -1;
+
+  reactor_http_server_session_timeout(session, 0);
+  return 0;
 }
 
 void reactor_http_server_session_close(reactor_http_server_session *session)
 {
   if (session->stream.state == REACTOR_STREAM_OPEN)
+    reactor_stream_close(&session->stream);
+}
+
+void reactor_http_server_session_link(reactor_http_server_session *session)
+{
+  session->active_prev = NULL;
+  session->active_next = session->server->sessions;
+  if (session->active_next)
+    session->active_next->active_prev = session;
+  session->server->sessions = session;
+}
+
+void reactor_http_server_session_unlink(reactor_http_server_session *session)
+{
+  if (session->active_prev)
+    session->active_prev->active_next = session->active_next;
+  else if (session->server->sessions == session)
+    session->server->sessions = session->active_next;
+  if (session->active_next)
+    session->active_next->active_prev = session->active_prev;
+  session->active_prev = NULL;
+  session->active_next = NULL;
+}
+
+void reactor_http_server_session_stream(reactor_http_server_session *session)
+{
+  /* only meaningful from REACTOR_HTTP_SERVER_REQUEST_HEADER, and only for the request being parsed; the header
+   * is consumed right after, so the request is only valid during that event and is cleared at REQUEST_END */
+  session->parser.flags |= REACTOR_HTTP_PARSER_FLAGS_STREAM;
+}
+
+void reactor_http_server_session_timeout(reactor_http_server_session *session, size_t input)
+{
+  int timeout;
+
+  if (session->stream.state != REACTOR_STREAM_OPEN)
+    return;
+
+  if (vector_size(&session->segments) || buffer_size(&session->stream.output))
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_WRITE;
+  else if (session->parser.state == REACTOR_HTTP_PARSER_BODY || session->parser.state == REACTOR_HTTP_PARSER_CHUNKED_BODY)
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_BODY;
+  else if (input)
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_HEADER;
+  else if (session->responses < session->requests || session->streaming)
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_NONE;
+  else if (session->server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM] &&
+           (!session->server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_IDLE] ||
+            session->server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM] < session->server->timeouts[REACTOR_HTTP_SERVER_TIMEOUT_IDLE]))
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM;
+  else
+    timeout = REACTOR_HTTP_SERVER_TIMEOUT_IDLE;
+
+  /* the header deadline runs from the first byte of a message, a client trickling in a header cannot extend it,
+   * a handler still working on a request is not cut off by the idle timeout */
+  if (timeout == REACTOR_HTTP_SERVER_TIMEOUT_HEADER && session->timeout == REACTOR_HTTP_SERVER_TIMEOUT_HEADER)
+    return;
+
+  session->timeout = timeout;
+  reactor_http_server_wheel_arm(session->server, session, session->server->timeouts[timeout]);
+}
+
+void reactor_http_server_session_reclaim(reactor_http_server_session *session)
+{
+  reactor_http_server_buffers *buffers;
+
+  if (buffer_size(&session->stream.input) || buffer_size(&session->stream.output) || vector_size(&session->segments) ||
+      buffer_size(&session->chunk))
+    return;
+
+  buffers = &session->server->buffers;
+  session->input_capacity = buffer_capacity(&session->stream.input);
+  session->output_capacity = buffer_capacity(&session->stream.output);
+  session->header_capacity = buffer_capacity(&session->header);
+  reactor_http_server_buffers_put(buffers, &session->stream.input);
+  reactor_http_server_buffers_put(buffers, &session->stream.output);
+  reactor_http_server_buffers_put(buffers, &session->header);
+  reactor_http_server_buffers_put(buffers, &session->deferred);
+  reactor_http_server_buffers_put(buffers, &session->chunk);
+}
+
+void reactor_http_server_session_reject(reactor_http_server_session *session, unsigned status)
+{
+  char data[128 + REACTOR_HTTP_DATE_SIZE];
+  size_t i, size, date_size;
+  int cork;
+
+  if (session->stream.state != REACTOR_STREAM_OPEN)
+    return;
+
+  for (i = 0; i < sizeof reactor_http_server_rejects / sizeof reactor_http_server_rejects[0]; i ++)
+    if (reactor_http_server_rejects[i].status == status)
+      break;
+  if (i == sizeof reactor_http_server_rejects / sizeof reactor_http_server_rejects[0])
+    return;
+
+  size = strlen(reactor_http_server_rejects[i].data);
+  date_size = strlen(session->server->date);
+  memcpy(data, reactor_http_server_rejects[i].data, size);
+  memcpy(data + size, session->server->date, date_size);
+  memcpy(data + size + date_size, "\r\n\r\n", 4);
+
+  /* the session is closed right after, so the response goes out now even when corked */
+  reactor_http_server_session_write(session, data, size + date_size + 4);
+  cork = session->cork;
+  session->cork = 0;
+  reactor_http_server_session_flush(session);
+  session->cork = cork;
+}
+
+void reactor_http_server_session_persist(reactor_http_server_session *session)
+{
+  reactor_http_request *request;
+  reactor_http_server_message message;
+  char *value;
+  size_t size;
+  int keep, e;
+
+  request = &session->request;
+  value = reactor_http_request_field_id(request, REACTOR_HTTP_FIELD_CONNECTION, &size);
+
+  /* HTTP/1.1 persists unless asked to close, HTTP/1.0 only when asked to keep alive */
+  keep = request->minor_version >= 1;
+  if (value)
+    keep = keep ? !reactor_http_token(value, size, "close") : reactor_http_token(value, size, "keep-alive");
+  if (session->server->requests_max && session->requests >= session->server->requests_max)
+    keep = 0;
+
+  /* responses may be written after later requests are parsed, so each one is answered with its own version */
+  message = (reactor_http_server_message) {.minor_version = request->minor_version, .close = !keep};
+  e = vector_push_back(&session->messages, &message);
+  if (e == -1)
     {
-      reactor_http_request_clear(&session->request);
-      reactor_stream_close(&session->stream);
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return;
     }
+  session->close = !keep;
+}
+
+void reactor_http_server_session_drained(reactor_http_server_session *session)
+{
+  /* close once the response to the last request has been written out completely */
+  if (session->close && !session->cork && !session->streaming && session->responses >= session->requests &&
+      !vector_size(&session->segments) && !buffer_size(&session->stream.output))
+    reactor_http_server_session_close(session);
+}
+
+int reactor_http_server_session_expect(reactor_http_server_session *session, unsigned status)
+{
+  /* only meaningful from REACTOR_HTTP_SERVER_REQUEST_EXPECT, 100 accepts the body and 413 or 417 refuse it */
+  if (status != 100 && status != 413 && status != 417)
+    return -1;
+
+  session->expect = status;
+  return 0;
 }
 
 int reactor_http_server_session_peer(reactor_http_server_session *session, struct sockaddr_in *sin, socklen_t *len)
@@ -174,6 +757,95 @@ int reactor_http_server_session_peer(reactor_http_server_session *session, struc
   return getpeername(reactor_desc_fd(&session->stream.desc), sin, len);
 }
 
+void reactor_http_server_session_data(reactor_http_server_session *session, reactor_stream_data *data)
+{
+  size_t size;
+
+  /* input after a request that ends the connection is discarded, the rest of that request is still read */
+  if (session->close && session->parser.state == REACTOR_HTTP_PARSER_REQUEST_HEADER)
+    {
+      reactor_stream_data_consume(data, data->size);
+      return;
+    }
+
+  /* buffers reclaimed while the session was idle are taken back from the server, sized by what the session used
+   * before, the input one before the stream keeps any unconsumed part of this read in it */
+  reactor_http_server_buffers_get(&session->server->buffers, &session->stream.input, session->input_capacity);
+  reactor_http_server_buffers_get(&session->server->buffers, &session->stream.output, session->output_capacity);
+  reactor_http_server_buffers_get(&session->server->buffers, &session->header, session->header_capacity);
+
+  /* responses produced while handling one read are coalesced and flushed together */
+  reactor_http_server_session_cork(session);
+
+  /* the parser completes at most one message per call, keep going while pipelined requests remain */
+  do
+    {
+      size = data->size;
+      reactor_http_parser_data(&session->parser, data);
+    }
+  while (data->size && data->size < size && session->parser.state == REACTOR_HTTP_PARSER_REQUEST_HEADER &&
+         session->stream.state == REACTOR_STREAM_OPEN && !session->close);
+
+  reactor_http_server_session_batch_dispatch(session);
+  reactor_http_server_session_uncork(session);
+  reactor_http_server_session_timeout(session, data->size);
+}
+
+void reactor_http_server_session_batch_push(reactor_http_server_session *session)
+{
+  reactor_http_request *slot, request;
+  int e;
+
+  if (session->batch_size == vector_size(&session->batch))
+    {
+      reactor_http_request_init(&request);
+      e = vector_push_back(&session->batch, &request);
+      if (e == -1)
+        {
+          reactor_http_request_clear(&request);
+          reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+          reactor_http_server_session_close(session);
+          return;
+        }
+    }
+
+  /* swap the completed request into the batch, the parser continues with the storage of an unused slot */
+  slot = vector_at(&session->batch, session->batch_size);
+  request = *slot;
+  *slot = session->request;
+  session->request = request;
+  vector_erase(&session->request.fields, 0, vector_size(&session->request.fields));
+  vector_erase(&session->request.ranges, 0, vector_size(&session->request.ranges));
+  session->request.content_fd = -1;
+  session->batch_size ++;
+
+  /* a spilled body is only valid until the next message is parsed */
+  if (slot->content_fd >= 0 || session->batch_size == REACTOR_HTTP_SERVER_BATCH_MAX)
+    reactor_http_server_session_batch_dispatch(session);
+}
+
+void reactor_http_server_session_batch_dispatch(reactor_http_server_session *session)
+{
+  size_t size;
+
+  size = session->batch_size;
+  if (!size)
+    return;
+  if (session->stream.state != REACTOR_STREAM_OPEN)
+    {
+      session->batch_size = 0;
+      return;
+    }
+
+  /* responses to the whole batch leave in one write */
+  session->batch_size = 0;
+  reactor_http_server_session_cork(session);
+  reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST_BATCH,
+                        (reactor_http_server_batch[]) {{.session = session, .requests = vector_data(&session->batch),
+                                                        .count = size}});
+  reactor_http_server_session_uncork(session);
+}
+
 void reactor_http_server_session_stream_event(void *state, int type, void *data)
 {
   reactor_http_server_session *session;
@@ -183,7 +855,7 @@ void reactor_http_server_session_stream_event(void *state, int type, void *data)
   switch (type)
     {
     case REACTOR_STREAM_DATA:
-      reactor_http_parser_data(&session->parser, data);
+      reactor_http_server_session_data(session, data);
       break;
     case REACTOR_STREAM_ERROR:
       reactor_http_server_session_close(session);
@@ -192,8 +864,21 @@ void reactor_http_server_session_stream_event(void *state, int type, void *data)
     case REACTOR_STREAM_END:
       reactor_http_server_session_close(session);
       break;
+    case REACTOR_STREAM_WRITE_AVAILABLE:
+      reactor_http_server_session_flush(session);
+      if (session->drain && !reactor_http_server_session_blocked(session))
+        {
+          session->drain = 0;
+          reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_DRAIN, session);
+        }
+      reactor_http_server_session_timeout(session, buffer_size(&session->stream.input));
+      break;
     case REACTOR_STREAM_CLOSE:
-      free(session);
+      reactor_http_server_session_unlink(session);
+      reactor_http_server_wheel_cancel(session->server, session);
+      reactor_http_parser_close(&session->parser);
+      reactor_http_server_session_release(session);
+      reactor_http_server_pool_put(session->server, session);
       break;
     }
 }
@@ -207,11 +892,57 @@ void reactor_http_server_session_parser_event(void *state, int type, void *data)
   switch (type)
     {
     case REACTOR_HTTP_PARSER_ERROR:
+      reactor_http_server_session_batch_dispatch(session);
+      if (session->parser.status)
+        reactor_http_server_session_reject(session, session->parser.status);
       reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
       reactor_http_server_session_close(session);
       break;
+    case REACTOR_HTTP_PARSER_HEADER:
+      reactor_http_server_session_batch_dispatch(session);
+      session->requests ++;
+      reactor_http_server_session_persist(session);
+      if (session->stream.state != REACTOR_STREAM_OPEN)
+        break;
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST_HEADER, session);
+      break;
+    case REACTOR_HTTP_PARSER_EXPECT:
+      reactor_http_server_session_batch_dispatch(session);
+      session->expect = 100;
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST_EXPECT, session);
+      if (session->stream.state != REACTOR_STREAM_OPEN)
+        break;
+      if (session->expect == 100)
+        reactor_http_server_session_write(session, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+      else
+        reactor_http_parser_reject(&session->parser, session->expect);
+      break;
+    case REACTOR_HTTP_PARSER_CHUNK:
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST_CHUNK,
+                            (reactor_http_server_chunk[]) {{.session = session, .base = ((reactor_stream_data *) data)->base,
+                                                            .size = ((reactor_stream_data *) data)->size}});
+      break;
     case REACTOR_HTTP_PARSER_DONE:
-      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST, session);
+      /* the next message gets a header deadline of its own */
+      if (session->timeout == REACTOR_HTTP_SERVER_TIMEOUT_HEADER)
+        session->timeout = REACTOR_HTTP_SERVER_TIMEOUT_NONE;
+      session->server->requests ++;
+      if (!(session->parser.flags & REACTOR_HTTP_PARSER_FLAGS_HEADER))
+        {
+          session->requests ++;
+          reactor_http_server_session_persist(session);
+          if (session->stream.state != REACTOR_STREAM_OPEN)
+            break;
+        }
+      if (session->parser.flags & REACTOR_HTTP_PARSER_FLAGS_STREAM)
+        {
+          session->parser.flags &= ~REACTOR_HTTP_PARSER_FLAGS_STREAM;
+          reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST_END, session);
+        }
+      else if (session->server->flags & REACTOR_HTTP_SERVER_FLAGS_BATCH)
+        reactor_http_server_session_batch_push(session);
+      else
+        reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_REQUEST, session);
       break;
     default:
       break;
@@ -228,17 +959,426 @@ void reactor_http_server_session_respond_fields(reactor_http_server_session *ses
                                                 char *content_type, char *content, size_t content_size,
                                                 reactor_http_field *fields, size_t nfields)
 {
-  reactor_http_response response;
+  reactor_http_builder builder;
+
+  reactor_http_builder_init(&builder, &session->header);
+  reactor_http_server_session_header(session, &builder, status, content_type, fields, nfields);
+
+  /* 1xx, 204 and 304 responses have neither a body nor a Content-Length */
+  if (status / 100 == 1 || status == 204 || status == 304)
+    content_size = 0;
+  else
+    {
+      reactor_http_builder_write(&builder, "Content-Length: ", 16);
+      reactor_http_builder_putu(&builder, content_size);
+      reactor_http_builder_write(&builder, "\r\n", 2);
+    }
+  reactor_http_builder_write(&builder, "\r\n", 2);
+  if (builder.error)
+    {
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return;
+    }
+
+  reactor_http_server_session_write(session, builder.data, builder.size);
+  if (content_size)
+    reactor_http_server_session_write(session, content, content_size);
+  reactor_http_server_session_flush(session);
+}
+
+void reactor_http_server_session_respond_reference(reactor_http_server_session *session, unsigned status,
+                                                   char *content_type, char *content, size_t content_size,
+                                                   reactor_http_field *fields, size_t nfields,
+                                                   reactor_user_call *release, void *state)
+{
+  reactor_http_builder builder;
+  reactor_user user;
+
+  if (content_size < REACTOR_HTTP_SERVER_REFERENCE_MIN || status / 100 == 1 || status == 204 || status == 304)
+    {
+      reactor_http_server_session_respond_fields(session, status, content_type, content, content_size, fields, nfields);
+      reactor_user_init(&user, release, state);
+      reactor_user_dispatch(&user, REACTOR_HTTP_SERVER_RELEASE, content);
+      return;
+    }
+
+  reactor_http_builder_init(&builder, &session->header);
+  reactor_http_server_session_header(session, &builder, status, content_type, fields, nfields);
+  reactor_http_builder_write(&builder, "Content-Length: ", 16);
+  reactor_http_builder_putu(&builder, content_size);
+  reactor_http_builder_write(&builder, "\r\n\r\n", 4);
+  if (builder.error)
+    {
+      reactor_user_init(&user, release, state);
+      reactor_user_dispatch(&user, REACTOR_HTTP_SERVER_RELEASE, content);
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return;
+    }
+
+  /* queue the header as a segment so it goes out in the same sendmsg() as the body */
+  reactor_http_server_session_write_copy(session, builder.data, builder.size);
+  reactor_http_server_session_write_reference(session, content, content_size, release, state);
+  reactor_http_server_session_flush(session);
+}
+
+void reactor_http_server_session_respond_begin(reactor_http_server_session *session, unsigned status,
+                                               char *content_type, reactor_http_field *fields, size_t nfields)
+{
+  reactor_http_builder builder;
+
+  reactor_http_builder_init(&builder, &session->header);
+  reactor_http_server_session_header(session, &builder, status, content_type, fields, nfields);
+  reactor_http_builder_write(&builder, "Transfer-Encoding: chunked\r\n\r\n", 30);
+  if (builder.error)
+    {
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return;
+    }
+
+  buffer_erase(&session->chunk, 0, buffer_size(&session->chunk));
+  session->streaming = 1;
+  reactor_http_server_session_write(session, builder.data, builder.size);
+}
+
+int reactor_http_server_session_respond_chunk(reactor_http_server_session *session, char *data, size_t size)
+{
+  int e;
+
+  /* chunks only belong in a response started with reactor_http_server_session_respond_begin() */
+  if (!session->streaming)
+    return -1;
+  if (!size)
+    return 0;
+
+  /* small chunks are batched and framed together */
+  if (buffer_size(&session->chunk) + size < REACTOR_HTTP_SERVER_CHUNK_BATCH)
+    {
+      e = buffer_insert(&session->chunk, buffer_size(&session->chunk), data, size);
+      if (e == -1)
+        {
+          reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+          reactor_http_server_session_close(session);
+        }
+      return 0;
+    }
+
+  reactor_http_server_session_chunk_flush(session);
+  reactor_http_server_session_chunk_write(session, data, size);
+  if (buffer_size(&session->stream.output) >= REACTOR_HTTP_SERVER_HIGH_WATER)
+    reactor_http_server_session_flush(session);
+  return 0;
+}
+
+int reactor_http_server_session_respond_end(reactor_http_server_session *session)
+{
+  if (!session->streaming)
+    return -1;
+
+  reactor_http_server_session_chunk_flush(session);
+  reactor_http_server_session_write(session, "0\r\n\r\n", 5);
+  session->streaming = 0;
+  reactor_http_server_session_flush(session);
+  return 0;
+}
+
+void reactor_http_server_session_chunk_flush(reactor_http_server_session *session)
+{
+  if (!buffer_size(&session->chunk))
+    return;
+
+  reactor_http_server_session_chunk_write(session, buffer_data(&session->chunk), buffer_size(&session->chunk));
+  buffer_erase(&session->chunk, 0, buffer_size(&session->chunk));
+}
+
+void reactor_http_server_session_chunk_write(reactor_http_server_session *session, char *data, size_t size)
+{
+  static const char hex[] = "0123456789abcdef";
+  char frame[2 * sizeof size + 2], *p;
+  size_t n;
+
+  p = frame + sizeof frame;
+  *-- p = '\n';
+  *-- p = '\r';
+  for (n = size; n; n >>= 4)
+    *-- p = hex[n & 15];
+  reactor_http_server_session_write(session, p, frame + sizeof frame - p);
+  reactor_http_server_session_write(session, data, size);
+  reactor_http_server_session_write(session, "\r\n", 2);
+}
+
+int reactor_http_server_session_blocked(reactor_http_server_session *session)
+{
+  /* a producer seeing the session blocked stops and continues on REACTOR_HTTP_SERVER_DRAIN */
+  if (vector_size(&session->segments) || buffer_size(&session->stream.output) >= REACTOR_HTTP_SERVER_HIGH_WATER)
+    {
+      session->drain = 1;
+      return 1;
+    }
+  return 0;
+}
+
+void reactor_http_server_session_write(reactor_http_server_session *session, char *data, size_t size)
+{
+  if (vector_size(&session->segments))
+    reactor_http_server_session_write_copy(session, data, size);
+  else
+    reactor_stream_write(&session->stream, data, size);
+}
+
+void reactor_http_server_session_write_copy(reactor_http_server_session *session, char *data, size_t size)
+{
+  reactor_http_server_segment *segment;
+  size_t offset;
+  int e;
+
+  offset = buffer_size(&session->deferred);
+  e = buffer_insert(&session->deferred, offset, data, size);
+  if (e == -1)
+    {
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return;
+    }
+
+  if (vector_size(&session->segments))
+    {
+      segment = vector_back(&session->segments);
+      if (segment->type == REACTOR_HTTP_SERVER_SEGMENT_COPY && segment->offset + segment->size == offset)
+        {
+          segment->size += size;
+          return;
+        }
+    }
+
+  e = vector_push_back(&session->segments, (reactor_http_server_segment[]) {{
+        .type = REACTOR_HTTP_SERVER_SEGMENT_COPY, .offset = offset, .size = size}});
+  if (e == -1)
+    {
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+    }
+}
+
+void reactor_http_server_session_write_reference(reactor_http_server_session *session, char *data, size_t size,
+                                                 reactor_user_call *release, void *state)
+{
+  reactor_http_server_segment segment;
+  int e;
+
+  segment = (reactor_http_server_segment) {.type = REACTOR_HTTP_SERVER_SEGMENT_REFERENCE, .base = data, .size = size};
+  reactor_user_init(&segment.release, release, state);
+  e = vector_push_back(&session->segments, &segment);
+  if (e == -1)
+    {
+      reactor_user_dispatch(&segment.release, REACTOR_HTTP_SERVER_RELEASE, data);
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+    }
+}
+
+void reactor_http_server_session_write_file(reactor_http_server_session *session, int fd, size_t offset, size_t size,
+                                            reactor_user_call *release, void *state)
+{
+  reactor_http_server_segment segment;
+  int e;
+
+  segment = (reactor_http_server_segment) {.type = REACTOR_HTTP_SERVER_SEGMENT_FILE, .base = state, .fd = fd,
+                                           .offset = offset, .size = size};
+  reactor_user_init(&segment.release, release, state);
+  e = vector_push_back(&session->segments, &segment);
+  if (e == -1)
+    {
+      reactor_user_dispatch(&segment.release, REACTOR_HTTP_SERVER_RELEASE, state);
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+    }
+}
+
+void reactor_http_server_session_cork(reactor_http_server_session *session)
+{
+  session->cork ++;
+}
+
+void reactor_http_server_session_uncork(reactor_http_server_session *session)
+{
+  if (session->cork && -- session->cork == 0)
+    reactor_http_server_session_flush(session);
+}
+
+void reactor_http_server_session_flush(reactor_http_server_session *session)
+{
+  reactor_http_server_segment *segment, released[REACTOR_HTTP_SERVER_IOV_MAX];
+  struct iovec iov[REACTOR_HTTP_SERVER_IOV_MAX];
+  struct msghdr message;
+  size_t i, n, done, nreleased, pending;
+  off_t offset;
+  ssize_t e;
+  char byte;
+
+  if (session->cork)
+    return;
+
+  while ((vector_size(&session->segments) || buffer_size(&session->stream.output)) &&
+         session->stream.state == REACTOR_STREAM_OPEN)
+    {
+      /* output already queued in the stream goes first, in the same sendmsg() as the segments that follow */
+      pending = buffer_size(&session->stream.output);
+      segment = vector_size(&session->segments) ? vector_front(&session->segments) : NULL;
+      if (!pending && segment->type == REACTOR_HTTP_SERVER_SEGMENT_FILE)
+        {
+          n = 1;
+          offset = segment->offset;
+          e = sendfile(reactor_desc_fd(&session->stream.desc), segment->fd, &offset, segment->size);
+          if (e == 0)
+            {
+              /* file shrunk under us */
+              errno = EIO;
+              e = -1;
+            }
+        }
+      else
+        {
+          i = 0;
+          if (pending)
+            iov[i ++] = (struct iovec) {.iov_base = buffer_data(&session->stream.output), .iov_len = pending};
+          for (n = 0; n < vector_size(&session->segments) && i < REACTOR_HTTP_SERVER_IOV_MAX; n ++, i ++)
+            {
+              segment = vector_at(&session->segments, n);
+              if (segment->type == REACTOR_HTTP_SERVER_SEGMENT_FILE)
+                break;
+              iov[i].iov_base = (segment->type == REACTOR_HTTP_SERVER_SEGMENT_COPY ?
+                                 (char *) buffer_data(&session->deferred) : segment->base) + segment->offset;
+              iov[i].iov_len = segment->size;
+            }
+
+          /* more is coming right after, let the kernel hold back a partial frame */
+          message = (struct msghdr) {.msg_iov = iov, .msg_iovlen = i};
+          e = sendmsg(reactor_desc_fd(&session->stream.desc), &message,
+                      MSG_NOSIGNAL | (n < vector_size(&session->segments) ? MSG_MORE : 0));
+        }
+      session->server->writes ++;
+
+      if (e == -1)
+        {
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              /* have the stream wait for the socket to become writable, continue on REACTOR_STREAM_WRITE_AVAILABLE */
+              if (pending)
+                {
+                  reactor_stream_flush(&session->stream);
+                  return;
+                }
+              if (segment->type != REACTOR_HTTP_SERVER_SEGMENT_FILE || pread(segment->fd, &byte, 1, segment->offset) == 1)
+                {
+                  /* hand one byte to the stream */
+                  reactor_stream_write(&session->stream, segment->type == REACTOR_HTTP_SERVER_SEGMENT_FILE ?
+                                       &byte : iov[0].iov_base, 1);
+                  reactor_stream_flush(&session->stream);
+                  e = 1;
+                }
+            }
+          if (e == -1)
+            {
+              reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+              reactor_http_server_session_close(session);
+              return;
+            }
+        }
+
+      if (pending)
+        {
+          if ((size_t) e < pending)
+            {
+              buffer_erase(&session->stream.output, 0, e);
+              continue;
+            }
+          buffer_erase(&session->stream.output, 0, pending);
+          e -= pending;
+        }
+
+      for (done = 0, nreleased = 0, i = 0; i < n; i ++)
+        {
+          segment = vector_at(&session->segments, i);
+          if ((size_t) e < segment->size)
+            {
+              segment->offset += e;
+              segment->size -= e;
+              break;
+            }
+
+          e -= segment->size;
+          if (segment->type != REACTOR_HTTP_SERVER_SEGMENT_COPY)
+            released[nreleased ++] = *segment;
+          done ++;
+        }
+      vector_erase(&session->segments, 0, done);
+
+      /* release callbacks may queue more output, so only dispatch once the queue is consistent */
+      for (i = 0; i < nreleased; i ++)
+        reactor_user_dispatch(&released[i].release, REACTOR_HTTP_SERVER_RELEASE, released[i].base);
+    }
+
+  if (!vector_size(&session->segments))
+    buffer_erase(&session->deferred, 0, buffer_size(&session->deferred));
+  reactor_http_server_session_drained(session);
+  reactor_http_server_session_timeout(session, buffer_size(&session->stream.input));
+}
+
+void reactor_http_server_session_release(reactor_http_server_session *session)
+{
+  reactor_http_server_segment segment;
+
+  while (vector_size(&session->segments))
+    {
+      segment = *(reactor_http_server_segment *) vector_front(&session->segments);
+      vector_erase(&session->segments, 0, 1);
+      if (segment.type != REACTOR_HTTP_SERVER_SEGMENT_COPY)
+        reactor_user_dispatch(&segment.release, REACTOR_HTTP_SERVER_RELEASE, segment.base);
+    }
+  buffer_erase(&session->deferred, 0, buffer_size(&session->deferred));
+}
+
+void reactor_http_server_session_header(reactor_http_server_session *session, reactor_http_builder *builder,
+                                        unsigned status, char *content_type, reactor_http_field *fields, size_t nfields)
+{
+  reactor_http_server_prefix *prefix;
+  reactor_http_server_message message;
   size_t i;
 
-  reactor_http_response_create(&response, status, content, content_size);
-  if (session->server->name)
-    reactor_http_response_add_header(&response, "Server", session->server->name);
-  reactor_http_response_add_header(&response, "Date", session->server->date);
+  prefix = reactor_http_server_prefix_lookup(session->server, status);
+  if (prefix)
+    reactor_http_builder_write(builder, prefix->data, prefix->size);
+  else
+    {
+      reactor_http_builder_write(builder, "HTTP/1.1 ", 9);
+      reactor_http_builder_putu(builder, status);
+      reactor_http_builder_write(builder, " ", 1);
+      reactor_http_builder_puts(builder, reactor_http_status_message(status));
+      reactor_http_builder_write(builder, "\r\n", 2);
+      if (session->server->name)
+        reactor_http_builder_field(builder, "Server", session->server->name);
+      reactor_http_builder_field(builder, "Date", session->server->date);
+    }
+
+  /* responses are written in request order, a response without a parsed request is taken as HTTP/1.1 */
+  session->responses ++;
+  message = (reactor_http_server_message) {.minor_version = 1};
+  if (vector_size(&session->messages))
+    {
+      message = *(reactor_http_server_message *) vector_front(&session->messages);
+      vector_erase(&session->messages, 0, 1);
+    }
+  if (message.close)
+    reactor_http_builder_write(builder, "Connection: close\r\n", 19);
+  else if (message.minor_version == 0)
+    reactor_http_builder_write(builder, "Connection: keep-alive\r\n", 24);
+
   if (content_type)
-    reactor_http_response_add_header(&response, "Content-Type", content_type);
+    reactor_http_builder_field(builder, "Content-Type", content_type);
   for (i = 0; i < nfields; i ++)
-    reactor_http_response_add_header(&response, fields[i].key, fields[i].value);
-  reactor_http_response_send(&response, &session->stream);
-  reactor_http_response_clear(&response);
+    if (fields[i].key && fields[i].value)
+      reactor_http_builder_field(builder, fields[i].key, fields[i].value);
 }
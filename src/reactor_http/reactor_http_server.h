@@ -6,7 +6,15 @@ enum reactor_http_server_event
   REACTOR_HTTP_SERVER_ERROR,
   REACTOR_HTTP_SERVER_ACCEPT,
   REACTOR_HTTP_SERVER_REQUEST,
-  REACTOR_HTTP_SERVER_CLOSE
+  REACTOR_HTTP_SERVER_CLOSE,
+  REACTOR_HTTP_SERVER_RELEASE,
+  REACTOR_HTTP_SERVER_START,
+  REACTOR_HTTP_SERVER_REQUEST_HEADER,
+  REACTOR_HTTP_SERVER_REQUEST_CHUNK,
+  REACTOR_HTTP_SERVER_REQUEST_END,
+  REACTOR_HTTP_SERVER_DRAIN,
+  REACTOR_HTTP_SERVER_REQUEST_BATCH,
+  REACTOR_HTTP_SERVER_REQUEST_EXPECT
 };
 
 enum reactor_http_server_state
@@ -16,45 +24,305 @@ enum reactor_http_server_state
   REACTOR_HTTP_SERVER_CLOSING
 };
 
+enum reactor_http_server_flags
+{
+  REACTOR_HTTP_SERVER_FLAGS_RANGES = 0x01,
+  REACTOR_HTTP_SERVER_FLAGS_STREAM = 0x02,
+  REACTOR_HTTP_SERVER_FLAGS_BATCH  = 0x04
+};
+
+enum reactor_http_server_timeout
+{
+  REACTOR_HTTP_SERVER_TIMEOUT_NONE,
+  REACTOR_HTTP_SERVER_TIMEOUT_HEADER,
+  REACTOR_HTTP_SERVER_TIMEOUT_BODY,
+  REACTOR_HTTP_SERVER_TIMEOUT_IDLE,
+  REACTOR_HTTP_SERVER_TIMEOUT_WRITE,
+  REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM,
+  REACTOR_HTTP_SERVER_TIMEOUT_MAX
+};
+
+enum reactor_http_server_segment_type
+{
+  REACTOR_HTTP_SERVER_SEGMENT_COPY,
+  REACTOR_HTTP_SERVER_SEGMENT_REFERENCE,
+  REACTOR_HTTP_SERVER_SEGMENT_FILE
+};
+
+#ifndef REACTOR_HTTP_SERVER_REFERENCE_MIN
+#define REACTOR_HTTP_SERVER_REFERENCE_MIN 16384
+#endif /* REACTOR_HTTP_SERVER_REFERENCE_MIN */
+
+#ifndef REACTOR_HTTP_SERVER_IOV_MAX
+#define REACTOR_HTTP_SERVER_IOV_MAX 64
+#endif /* REACTOR_HTTP_SERVER_IOV_MAX */
+
+#ifndef REACTOR_HTTP_SERVER_POOL_MAX
+#define REACTOR_HTTP_SERVER_POOL_MAX 1024
+#endif /* REACTOR_HTTP_SERVER_POOL_MAX */
+
+#ifndef REACTOR_HTTP_SERVER_PREFIX_SIZE
+#define REACTOR_HTTP_SERVER_PREFIX_SIZE 256
+#endif /* REACTOR_HTTP_SERVER_PREFIX_SIZE */
+
+#define REACTOR_HTTP_SERVER_PREFIX_MAX 14
+
+#ifndef REACTOR_HTTP_SERVER_CHUNK_BATCH
+#define REACTOR_HTTP_SERVER_CHUNK_BATCH 8192
+#endif /* REACTOR_HTTP_SERVER_CHUNK_BATCH */
+
+#ifndef REACTOR_HTTP_SERVER_HIGH_WATER
+#define REACTOR_HTTP_SERVER_HIGH_WATER 65536
+#endif /* REACTOR_HTTP_SERVER_HIGH_WATER */
+
+#ifndef REACTOR_HTTP_SERVER_BATCH_MAX
+#define REACTOR_HTTP_SERVER_BATCH_MAX 64
+#endif /* REACTOR_HTTP_SERVER_BATCH_MAX */
+
+#ifndef REACTOR_HTTP_SERVER_WHEEL_SIZE
+#define REACTOR_HTTP_SERVER_WHEEL_SIZE 64
+#endif /* REACTOR_HTTP_SERVER_WHEEL_SIZE */
+
+#ifndef REACTOR_HTTP_SERVER_HEADER_TIMEOUT
+#define REACTOR_HTTP_SERVER_HEADER_TIMEOUT 10
+#endif /* REACTOR_HTTP_SERVER_HEADER_TIMEOUT */
+
+#ifndef REACTOR_HTTP_SERVER_BODY_TIMEOUT
+#define REACTOR_HTTP_SERVER_BODY_TIMEOUT 30
+#endif /* REACTOR_HTTP_SERVER_BODY_TIMEOUT */
+
+#ifndef REACTOR_HTTP_SERVER_IDLE_TIMEOUT
+#define REACTOR_HTTP_SERVER_IDLE_TIMEOUT 60
+#endif /* REACTOR_HTTP_SERVER_IDLE_TIMEOUT */
+
+#ifndef REACTOR_HTTP_SERVER_WRITE_TIMEOUT
+#define REACTOR_HTTP_SERVER_WRITE_TIMEOUT 30
+#endif /* REACTOR_HTTP_SERVER_WRITE_TIMEOUT */
+
+#ifndef REACTOR_HTTP_SERVER_RECLAIM_TIMEOUT
+#define REACTOR_HTTP_SERVER_RECLAIM_TIMEOUT 1
+#endif /* REACTOR_HTTP_SERVER_RECLAIM_TIMEOUT */
+
+#ifndef REACTOR_HTTP_SERVER_BUFFERS_MIN
+#define REACTOR_HTTP_SERVER_BUFFERS_MIN 4096
+#endif /* REACTOR_HTTP_SERVER_BUFFERS_MIN */
+
+#ifndef REACTOR_HTTP_SERVER_BUFFERS_CLASSES
+#define REACTOR_HTTP_SERVER_BUFFERS_CLASSES 5
+#endif /* REACTOR_HTTP_SERVER_BUFFERS_CLASSES */
+
+#ifndef REACTOR_HTTP_SERVER_BUFFERS_MAX
+#define REACTOR_HTTP_SERVER_BUFFERS_MAX 1024
+#endif /* REACTOR_HTTP_SERVER_BUFFERS_MAX */
+
+typedef struct reactor_http_server_session reactor_http_server_session;
+
+typedef struct reactor_http_server_wheel reactor_http_server_wheel;
+struct reactor_http_server_wheel
+{
+  uint64_t               now;
+  reactor_http_server_session *slots[REACTOR_HTTP_SERVER_WHEEL_SIZE];
+  reactor_http_server_session *laps[REACTOR_HTTP_SERVER_WHEEL_SIZE];
+};
+
+typedef struct reactor_http_server_buffers reactor_http_server_buffers;
+struct reactor_http_server_buffers
+{
+  vector                 classes[REACTOR_HTTP_SERVER_BUFFERS_CLASSES];
+  size_t                 max;
+  size_t                 hits;
+  size_t                 misses;
+};
+
+typedef struct reactor_http_server_prefix reactor_http_server_prefix;
+struct reactor_http_server_prefix
+{
+  unsigned               status;
+  size_t                 size;
+  char                   data[REACTOR_HTTP_SERVER_PREFIX_SIZE];
+};
+
+typedef struct reactor_http_server_pool reactor_http_server_pool;
+struct reactor_http_server_pool
+{
+  vector                 sessions;
+  size_t                 prewarm;
+  size_t                 max;
+  size_t                 used;
+  size_t                 hits;
+  size_t                 misses;
+  size_t                 high_water;
+};
+
 typedef struct reactor_http_server reactor_http_server;
 struct reactor_http_server
 {
   int                    state;
+  int                    flags;
+  size_t                 spill;
   reactor_user           user;
   reactor_tcp_server     tcp_server;
   reactor_timer          date_timer;
-  char                   date[32];
+  char                   date[REACTOR_HTTP_DATE_SIZE];
   char                  *name;
+  reactor_http_server_pool pool;
+  reactor_http_server_prefix prefix[REACTOR_HTTP_SERVER_PREFIX_MAX];
+  size_t                 requests;
+  size_t                 writes;
+  reactor_http_server_wheel wheel;
+  reactor_http_server_buffers buffers;
+  unsigned               timeouts[REACTOR_HTTP_SERVER_TIMEOUT_MAX];
+  size_t                 header_max;
+  size_t                 fields_max;
+  size_t                 uri_max;
+  size_t                 body_max;
+  size_t                 requests_max;
+  reactor_http_server_session *sessions;
+};
+
+typedef struct reactor_http_server_segment reactor_http_server_segment;
+struct reactor_http_server_segment
+{
+  int                    type;
+  char                  *base;
+  int                    fd;
+  size_t                 offset;
+  size_t                 size;
+  reactor_user           release;
+};
+
+typedef struct reactor_http_server_message reactor_http_server_message;
+struct reactor_http_server_message
+{
+  int                    minor_version;
+  int                    close;
+};
+
+typedef struct reactor_http_server_chunk reactor_http_server_chunk;
+struct reactor_http_server_chunk
+{
+  reactor_http_server_session *session;
+  char                  *base;
+  size_t                 size;
+};
+
+typedef struct reactor_http_server_batch reactor_http_server_batch;
+struct reactor_http_server_batch
+{
+  reactor_http_server_session *session;
+  reactor_http_request  *requests;
+  size_t                 count;
 };
 
-typedef struct reactor_http_server_session reactor_http_server_session;
 struct reactor_http_server_session
 {
   reactor_stream         stream;
   reactor_http_request   request;
   reactor_http_parser    parser;
   reactor_http_server   *server;
+  buffer                 header;
+  vector                 segments;
+  buffer                 deferred;
+  buffer                 chunk;
+  size_t                 input_capacity;
+  size_t                 output_capacity;
+  size_t                 header_capacity;
+  int                    drain;
+  vector                 batch;
+  size_t                 batch_size;
+  int                    cork;
+  int                    timeout;
+  uint64_t               deadline;
+  reactor_http_server_session **wheel_slot;
+  reactor_http_server_session *wheel_prev;
+  reactor_http_server_session *wheel_next;
+  reactor_http_server_session *active_prev;
+  reactor_http_server_session *active_next;
+  size_t                 requests;
+  size_t                 responses;
+  vector                 messages;
+  int                    close;
+  int                    streaming;
+  unsigned               expect;
 };
 
 void reactor_http_server_init(reactor_http_server *, reactor_user_call *, void *);
 int  reactor_http_server_open(reactor_http_server *, char *, char *);
 void reactor_http_server_name(reactor_http_server *, char *);
+void reactor_http_server_flags(reactor_http_server *, int);
+void reactor_http_server_spill(reactor_http_server *, size_t);
 void reactor_http_server_error(reactor_http_server *);
 void reactor_http_server_close(reactor_http_server *);
+void reactor_http_server_shutdown(reactor_http_server *);
+void reactor_http_server_pool_size(reactor_http_server *, size_t, size_t);
+void reactor_http_server_timeouts(reactor_http_server *, unsigned, unsigned, unsigned, unsigned);
+void reactor_http_server_reclaim(reactor_http_server *, unsigned);
+void reactor_http_server_limits(reactor_http_server *, size_t, size_t, size_t, size_t);
+void reactor_http_server_requests_max(reactor_http_server *, size_t);
 
 void reactor_http_server_tcp_event(void *, int, void *);
 
 void reactor_http_server_date_event(void *, int, void *);
 void reactor_http_server_date_update(reactor_http_server *);
+void reactor_http_server_prefix_update(reactor_http_server *);
+reactor_http_server_prefix *reactor_http_server_prefix_lookup(reactor_http_server *, unsigned);
+
+void reactor_http_server_wheel_arm(reactor_http_server *, reactor_http_server_session *, unsigned);
+void reactor_http_server_wheel_insert(reactor_http_server *, reactor_http_server_session *);
+void reactor_http_server_wheel_cancel(reactor_http_server *, reactor_http_server_session *);
+void reactor_http_server_wheel_tick(reactor_http_server *);
+
+void reactor_http_server_buffers_init(reactor_http_server_buffers *);
+void reactor_http_server_buffers_get(reactor_http_server_buffers *, buffer *, size_t);
+void reactor_http_server_buffers_put(reactor_http_server_buffers *, buffer *);
+void reactor_http_server_buffers_clear(reactor_http_server_buffers *);
+
+void reactor_http_server_pool_init(reactor_http_server_pool *);
+int  reactor_http_server_pool_prewarm(reactor_http_server *);
+reactor_http_server_session *reactor_http_server_pool_get(reactor_http_server *);
+void reactor_http_server_pool_put(reactor_http_server *, reactor_http_server_session *);
+void reactor_http_server_pool_clear(reactor_http_server_pool *);
 
 void reactor_http_server_session_init(reactor_http_server_session *, reactor_http_server *);
+void reactor_http_server_session_reset(reactor_http_server_session *);
+void reactor_http_server_session_free(reactor_http_server_session *);
 int  reactor_http_server_session_open(reactor_http_server_session *, int);
 void reactor_http_server_session_close(reactor_http_server_session *);
+void reactor_http_server_session_link(reactor_http_server_session *);
+void reactor_http_server_session_unlink(reactor_http_server_session *);
+void reactor_http_server_session_stream(reactor_http_server_session *);
+int  reactor_http_server_session_expect(reactor_http_server_session *, unsigned);
+void reactor_http_server_session_timeout(reactor_http_server_session *, size_t);
+void reactor_http_server_session_reclaim(reactor_http_server_session *);
+void reactor_http_server_session_reject(reactor_http_server_session *, unsigned);
+void reactor_http_server_session_persist(reactor_http_server_session *);
+void reactor_http_server_session_drained(reactor_http_server_session *);
 int  reactor_http_server_session_peer(reactor_http_server_session *, struct sockaddr_in *, socklen_t *);
+void reactor_http_server_session_data(reactor_http_server_session *, reactor_stream_data *);
+void reactor_http_server_session_batch_push(reactor_http_server_session *);
+void reactor_http_server_session_batch_dispatch(reactor_http_server_session *);
 void reactor_http_server_session_stream_event(void *, int, void *);
 void reactor_http_server_session_parser_event(void *, int, void *);
 void reactor_http_server_session_respond(reactor_http_server_session *, unsigned, char *, char *, size_t);
 void reactor_http_server_session_respond_fields(reactor_http_server_session *, unsigned, char *, char *, size_t,
                                                 reactor_http_field *, size_t);
+void reactor_http_server_session_respond_reference(reactor_http_server_session *, unsigned, char *, char *, size_t,
+                                                   reactor_http_field *, size_t, reactor_user_call *, void *);
+void reactor_http_server_session_respond_begin(reactor_http_server_session *, unsigned, char *, reactor_http_field *, size_t);
+int  reactor_http_server_session_respond_chunk(reactor_http_server_session *, char *, size_t);
+int  reactor_http_server_session_respond_end(reactor_http_server_session *);
+void reactor_http_server_session_chunk_flush(reactor_http_server_session *);
+void reactor_http_server_session_chunk_write(reactor_http_server_session *, char *, size_t);
+int  reactor_http_server_session_blocked(reactor_http_server_session *);
+void reactor_http_server_session_write(reactor_http_server_session *, char *, size_t);
+void reactor_http_server_session_write_copy(reactor_http_server_session *, char *, size_t);
+void reactor_http_server_session_write_reference(reactor_http_server_session *, char *, size_t, reactor_user_call *, void *);
+void reactor_http_server_session_write_file(reactor_http_server_session *, int, size_t, size_t, reactor_user_call *, void *);
+void reactor_http_server_session_cork(reactor_http_server_session *);
+void reactor_http_server_session_uncork(reactor_http_server_session *);
+void reactor_http_server_session_flush(reactor_http_server_session *);
+void reactor_http_server_session_release(reactor_http_server_session *);
+void reactor_http_server_session_header(reactor_http_server_session *, reactor_http_builder *, unsigned, char *,
+                                        reactor_http_field *, size_t);
 
 #endif /* REACTOR_HTTP_SERVER_H_INCLUDED */
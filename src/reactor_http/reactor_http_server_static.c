@@ -0,0 +1,430 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif /* SYS_openat2 */
+
+#include <dynamic.h>
+#include <clo.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+#include "reactor_http_parser.h"
+#include "reactor_http_server.h"
+#include "reactor_http_server_static.h"
+
+typedef struct reactor_http_server_static_mime reactor_http_server_static_mime;
+struct reactor_http_server_static_mime
+{
+  char                  *extension;
+  char                  *type;
+};
+
+static const reactor_http_server_static_mime reactor_http_server_static_mimes[] =
+  {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "application/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"mp4", "video/mp4"},
+    {"webm", "video/webm"}
+  };
+
+int      reactor_http_server_static_valid(char *);
+int      reactor_http_server_static_openat(int, char *, int);
+uint64_t reactor_http_server_static_hash(char *);
+
+void reactor_http_server_static_init(reactor_http_server_static *s)
+{
+  *s = (reactor_http_server_static) {.dir = -1};
+}
+
+int reactor_http_server_static_open(reactor_http_server_static *s, char *prefix, char *directory, size_t max)
+{
+  s->prefix = prefix;
+  s->prefix_size = strlen(prefix);
+  s->max = max ? max : REACTOR_HTTP_SERVER_STATIC_MAX;
+  for (s->buckets_size = 16; s->buckets_size < s->max * 2; s->buckets_size *= 2);
+  s->buckets = calloc(s->buckets_size, sizeof *s->buckets);
+  if (!s->buckets)
+    return -1;
+
+  s->dir = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (s->dir == -1)
+    {
+      free(s->buckets);
+      s->buckets = NULL;
+      return -1;
+    }
+
+  return 0;
+}
+
+void reactor_http_server_static_close(reactor_http_server_static *s)
+{
+  while (s->head)
+    reactor_http_server_static_evict(s, s->head);
+  free(s->buckets);
+  s->buckets = NULL;
+  if (s->dir >= 0)
+    (void) close(s->dir);
+  s->dir = -1;
+}
+
+int reactor_http_server_static_respond(reactor_http_server_static *s, reactor_http_server_session *session,
+                                       reactor_http_request *request)
+{
+  reactor_http_server_static_entry *entry;
+  reactor_http_builder builder;
+  char *path, *method, *value, *p, local[PATH_MAX];
+  size_t size, method_size, value_size;
+  ssize_t n;
+  int head;
+
+  path = reactor_http_request_path(request, &size);
+  if (size < s->prefix_size || memcmp(path, s->prefix, s->prefix_size) != 0)
+    return -1;
+  if (size > s->prefix_size && s->prefix_size && s->prefix[s->prefix_size - 1] != '/' &&
+      path[s->prefix_size] != '/' && path[s->prefix_size] != '?')
+    return -1;
+
+  method = reactor_http_request_method(request, &method_size);
+  head = method_size == 4 && memcmp(method, "HEAD", 4) == 0;
+  if (!head && !(method_size == 3 && memcmp(method, "GET", 3) == 0))
+    {
+      reactor_http_server_session_respond_fields(session, 405, NULL, NULL, 0,
+                                                 (reactor_http_field[]) {{.key = "Allow", .value = "GET, HEAD"}}, 1);
+      return 0;
+    }
+
+  path += s->prefix_size;
+  size -= s->prefix_size;
+  p = memchr(path, '?', size);
+  if (p)
+    size = p - path;
+
+  /* only plain relative paths below the directory are served, checked after percent decoding */
+  n = size + sizeof "index.html" > sizeof local ? -1 : reactor_http_url_decode(local, path, size);
+  if (n == -1 || memchr(local, '\0', n))
+    {
+      reactor_http_server_session_respond(session, 404, NULL, NULL, 0);
+      return 0;
+    }
+  for (path = local, size = n; size && *path == '/'; path ++, size --);
+  memmove(local, path, size);
+  if (size == 0 || local[size - 1] == '/')
+    {
+      memcpy(local + size, "index.html", sizeof "index.html" - 1);
+      size += sizeof "index.html" - 1;
+    }
+  local[size] = '\0';
+  if (!reactor_http_server_static_valid(local))
+    {
+      reactor_http_server_session_respond(session, 404, NULL, NULL, 0);
+      return 0;
+    }
+
+  entry = reactor_http_server_static_lookup(s, local);
+  if (!entry)
+    {
+      reactor_http_server_session_respond(session, 404, NULL, NULL, 0);
+      return 0;
+    }
+
+  value = reactor_http_request_field_id(request, REACTOR_HTTP_FIELD_IF_MODIFIED_SINCE, &value_size);
+  if (value && value_size == strlen(entry->modified) && memcmp(value, entry->modified, value_size) == 0)
+    {
+      reactor_http_server_session_respond(session, 304, NULL, NULL, 0);
+      return 0;
+    }
+
+  reactor_http_builder_init(&builder, &session->header);
+  reactor_http_server_session_header(session, &builder, 200, NULL, NULL, 0);
+  reactor_http_builder_write(&builder, entry->header, entry->header_size);
+  reactor_http_builder_write(&builder, "\r\n", 2);
+  if (builder.error)
+    {
+      reactor_user_dispatch(&session->server->user, REACTOR_HTTP_SERVER_ERROR, NULL);
+      reactor_http_server_session_close(session);
+      return 0;
+    }
+
+  reactor_http_server_session_write_copy(session, builder.data, builder.size);
+  if (!head && entry->size)
+    {
+      entry->refs ++;
+      reactor_http_server_session_write_file(session, entry->fd, 0, entry->size, reactor_http_server_static_release, entry);
+    }
+  reactor_http_server_session_flush(session);
+  return 0;
+}
+
+char *reactor_http_server_static_type(char *path)
+{
+  char *extension;
+  size_t i;
+
+  extension = strrchr(path, '.');
+  if (extension && !strchr(extension, '/'))
+    for (i = 0; i < sizeof reactor_http_server_static_mimes / sizeof reactor_http_server_static_mimes[0]; i ++)
+      if (strcasecmp(extension + 1, reactor_http_server_static_mimes[i].extension) == 0)
+        return reactor_http_server_static_mimes[i].type;
+  return "application/octet-stream";
+}
+
+reactor_http_server_static_entry *reactor_http_server_static_lookup(reactor_http_server_static *s, char *path)
+{
+  reactor_http_server_static_entry *entry;
+  struct stat st;
+  uint64_t hash;
+  time_t now;
+  int fd, e;
+
+  hash = reactor_http_server_static_hash(path);
+  for (entry = s->buckets[hash & (s->buckets_size - 1)]; entry; entry = entry->chain)
+    if (entry->hash == hash && strcmp(entry->path, path) == 0)
+      break;
+
+  if (entry)
+    {
+      /* revalidate against the file system at most once per second */
+      now = time(NULL);
+      if (entry->checked != now)
+        {
+          entry->checked = now;
+          fd = reactor_http_server_static_openat(s->dir, path, O_PATH);
+          e = fd == -1 ? -1 : fstat(fd, &st);
+          if (fd >= 0)
+            (void) close(fd);
+          if (e == -1 || st.st_ino != entry->ino || (size_t) st.st_size != entry->size ||
+              st.st_mtim.tv_sec != entry->mtime.tv_sec || st.st_mtim.tv_nsec != entry->mtime.tv_nsec)
+            {
+              reactor_http_server_static_evict(s, entry);
+              entry = NULL;
+            }
+        }
+    }
+
+  if (!entry)
+    {
+      s->misses ++;
+      return reactor_http_server_static_load(s, path, hash);
+    }
+
+  s->hits ++;
+  if (entry != s->head)
+    {
+      entry->prev->next = entry->next;
+      if (entry->next)
+        entry->next->prev = entry->prev;
+      else
+        s->tail = entry->prev;
+      entry->prev = NULL;
+      entry->next = s->head;
+      s->head->prev = entry;
+      s->head = entry;
+    }
+  return entry;
+}
+
+reactor_http_server_static_entry *reactor_http_server_static_load(reactor_http_server_static *s, char *path, uint64_t hash)
+{
+  reactor_http_server_static_entry *entry, **bucket;
+  struct stat st;
+  int fd, e, n;
+
+  fd = reactor_http_server_static_openat(s->dir, path, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+
+  e = fstat(fd, &st);
+  if (e == -1 || !S_ISREG(st.st_mode))
+    {
+      (void) close(fd);
+      return NULL;
+    }
+
+  entry = malloc(sizeof *entry);
+  if (entry)
+    {
+      *entry = (reactor_http_server_static_entry) {.hash = hash, .fd = fd, .size = st.st_size, .ino = st.st_ino,
+                                                   .mtime = st.st_mtim, .checked = time(NULL)};
+      entry->path = strdup(path);
+    }
+  if (!entry || !entry->path)
+    {
+      free(entry);
+      (void) close(fd);
+      return NULL;
+    }
+
+  reactor_http_date(entry->modified, st.st_mtim.tv_sec);
+  n = snprintf(entry->header, sizeof entry->header, "Content-Type: %s\r\nContent-Length: %zu\r\nLast-Modified: %s\r\n",
+               reactor_http_server_static_type(path), entry->size, entry->modified);
+  if (n < 0 || (size_t) n >= sizeof entry->header)
+    {
+      free(entry->path);
+      free(entry);
+      (void) close(fd);
+      return NULL;
+    }
+  entry->header_size = n;
+
+  if (s->count >= s->max)
+    reactor_http_server_static_evict(s, s->tail);
+
+  bucket = &s->buckets[hash & (s->buckets_size - 1)];
+  entry->chain = *bucket;
+  *bucket = entry;
+  entry->next = s->head;
+  if (s->head)
+    s->head->prev = entry;
+  else
+    s->tail = entry;
+  s->head = entry;
+  s->count ++;
+  return entry;
+}
+
+void reactor_http_server_static_evict(reactor_http_server_static *s, reactor_http_server_static_entry *entry)
+{
+  reactor_http_server_static_entry **link;
+
+  for (link = &s->buckets[entry->hash & (s->buckets_size - 1)]; *link != entry; link = &(*link)->chain);
+  *link = entry->chain;
+
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  else
+    s->head = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  else
+    s->tail = entry->prev;
+  s->count --;
+
+  /* sessions still sending the file keep it open until released */
+  entry->evicted = 1;
+  if (!entry->refs)
+    reactor_http_server_static_release(entry, REACTOR_HTTP_SERVER_RELEASE, NULL);
+}
+
+void reactor_http_server_static_release(void *state, int type, void *data)
+{
+  reactor_http_server_static_entry *entry;
+
+  (void) data;
+  entry = state;
+  if (type != REACTOR_HTTP_SERVER_RELEASE)
+    return;
+
+  if (entry->refs)
+    entry->refs --;
+  if (entry->evicted && !entry->refs)
+    {
+      (void) close(entry->fd);
+      free(entry->path);
+      free(entry);
+    }
+}
+
+int reactor_http_server_static_valid(char *path)
+{
+  char *segment, *end;
+
+  for (segment = path;; segment = end + 1)
+    {
+      if (strncmp(segment, "..", 2) == 0 && (segment[2] == '/' || segment[2] == '\0'))
+        return 0;
+      end = strchr(segment, '/');
+      if (!end)
+        return 1;
+    }
+}
+
+int reactor_http_server_static_openat(int dir, char *path, int flags)
+{
+  char *segment, *end, name[NAME_MAX + 1];
+  size_t size;
+  int fd, next;
+#ifdef SYS_openat2
+  struct open_how how = {.flags = flags | O_CLOEXEC | O_NOFOLLOW, .resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS};
+
+  fd = syscall(SYS_openat2, dir, path, &how, sizeof how);
+  if (fd >= 0 || (errno != ENOSYS && errno != EPERM))
+    return fd;
+#endif /* SYS_openat2 */
+
+  /* without openat2(), or where a seccomp filter denies it with EPERM, the path is walked one directory at a time, none of them may be a symbolic link */
+  if (*path == '/')
+    {
+      errno = EXDEV;
+      return -1;
+    }
+
+  fd = dir;
+  for (segment = path; (end = strchr(segment, '/')); segment = end + 1)
+    {
+      size = end - segment;
+      if (!size)
+        continue;
+      if (size > NAME_MAX)
+        {
+          errno = ENAMETOOLONG;
+          next = -1;
+        }
+      else
+        {
+          memcpy(name, segment, size);
+          name[size] = '\0';
+          next = openat(fd, name, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+      if (fd != dir)
+        (void) close(fd);
+      if (next == -1)
+        return -1;
+      fd = next;
+    }
+
+  next = openat(fd, segment, flags | O_NOFOLLOW | O_CLOEXEC);
+  if (fd != dir)
+    (void) close(fd);
+  return next;
+}
+
+uint64_t reactor_http_server_static_hash(char *path)
+{
+  uint64_t hash;
+
+  for (hash = 14695981039346656037ULL; *path; path ++)
+    hash = (hash ^ (unsigned char) *path) * 1099511628211ULL;
+  return hash;
+}
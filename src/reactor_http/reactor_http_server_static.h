@@ -0,0 +1,59 @@
+#ifndef REACTOR_HTTP_SERVER_STATIC_H_INCLUDED
+#define REACTOR_HTTP_SERVER_STATIC_H_INCLUDED
+
+#ifndef REACTOR_HTTP_SERVER_STATIC_MAX
+#define REACTOR_HTTP_SERVER_STATIC_MAX 1024
+#endif /* REACTOR_HTTP_SERVER_STATIC_MAX */
+
+#ifndef REACTOR_HTTP_SERVER_STATIC_HEADER_SIZE
+#define REACTOR_HTTP_SERVER_STATIC_HEADER_SIZE 160
+#endif /* REACTOR_HTTP_SERVER_STATIC_HEADER_SIZE */
+
+typedef struct reactor_http_server_static_entry reactor_http_server_static_entry;
+struct reactor_http_server_static_entry
+{
+  reactor_http_server_static_entry *prev;
+  reactor_http_server_static_entry *next;
+  reactor_http_server_static_entry *chain;
+  uint64_t               hash;
+  char                  *path;
+  int                    fd;
+  size_t                 size;
+  ino_t                  ino;
+  struct timespec        mtime;
+  time_t                 checked;
+  size_t                 refs;
+  int                    evicted;
+  char                   modified[REACTOR_HTTP_DATE_SIZE];
+  size_t                 header_size;
+  char                   header[REACTOR_HTTP_SERVER_STATIC_HEADER_SIZE];
+};
+
+typedef struct reactor_http_server_static reactor_http_server_static;
+struct reactor_http_server_static
+{
+  char                  *prefix;
+  size_t                 prefix_size;
+  int                    dir;
+  size_t                 max;
+  size_t                 count;
+  size_t                 buckets_size;
+  reactor_http_server_static_entry **buckets;
+  reactor_http_server_static_entry *head;
+  reactor_http_server_static_entry *tail;
+  size_t                 hits;
+  size_t                 misses;
+};
+
+void  reactor_http_server_static_init(reactor_http_server_static *);
+int   reactor_http_server_static_open(reactor_http_server_static *, char *, char *, size_t);
+void  reactor_http_server_static_close(reactor_http_server_static *);
+int   reactor_http_server_static_respond(reactor_http_server_static *, reactor_http_server_session *, reactor_http_request *);
+char *reactor_http_server_static_type(char *);
+
+reactor_http_server_static_entry *reactor_http_server_static_lookup(reactor_http_server_static *, char *);
+reactor_http_server_static_entry *reactor_http_server_static_load(reactor_http_server_static *, char *, uint64_t);
+void  reactor_http_server_static_evict(reactor_http_server_static *, reactor_http_server_static_entry *);
+void  reactor_http_server_static_release(void *, int, void *);
+
+#endif /* REACTOR_HTTP_SERVER_STATIC_H_INCLUDED */
@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <linux/filter.h>
+
+#include <dynamic.h>
+#include <clo.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+#include "reactor_http_parser.h"
+#include "reactor_http_server.h"
+#include "reactor_http_server_workers.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif /* SO_ATTACH_REUSEPORT_CBPF */
+
+int reactor_http_server_workers_run(reactor_http_server_workers *workers, size_t count, int flags,
+                                    reactor_user_call *call, void *state, char *node, char *service)
+{
+  size_t i, started;
+  int e;
+
+  *workers = (reactor_http_server_workers) {.count = count, .flags = flags, .node = node, .service = service,
+                                            .call = call, .state = state};
+  workers->worker = calloc(count, sizeof *workers->worker);
+  if (!workers->worker)
+    return -1;
+  (void) pthread_mutex_init(&workers->mutex, NULL);
+  (void) pthread_cond_init(&workers->cond, NULL);
+
+  for (i = 0; i < count; i ++)
+    workers->worker[i] = (reactor_http_server_worker) {.index = i, .fd = -1, .workers = workers};
+
+  for (started = 0; started < count; started ++)
+    {
+      e = pthread_create(&workers->worker[started].thread, NULL, reactor_http_server_workers_thread,
+                         &workers->worker[started]);
+      if (e != 0)
+        break;
+    }
+
+  /* workers that never start must not block the ones waiting for their turn to open, the rest are stopped */
+  if (started < count)
+    {
+      (void) pthread_mutex_lock(&workers->mutex);
+      workers->count = started;
+      (void) pthread_cond_broadcast(&workers->cond);
+      (void) pthread_mutex_unlock(&workers->mutex);
+      reactor_http_server_workers_stop(workers);
+    }
+
+  e = started == count ? 0 : -1;
+  for (i = 0; i < started; i ++)
+    {
+      (void) pthread_join(workers->worker[i].thread, NULL);
+      if (workers->worker[i].error)
+        e = -1;
+    }
+
+  (void) pthread_cond_destroy(&workers->cond);
+  (void) pthread_mutex_destroy(&workers->mutex);
+  free(workers->worker);
+  workers->worker = NULL;
+  return e;
+}
+
+void reactor_http_server_workers_stop(reactor_http_server_workers *workers)
+{
+  uint64_t one = 1;
+  ssize_t n;
+  size_t i;
+
+  /* may be called from any thread while reactor_http_server_workers_run() is in progress */
+  (void) pthread_mutex_lock(&workers->mutex);
+  workers->stop = 1;
+  (void) pthread_cond_broadcast(&workers->cond);
+  for (i = 0; i < workers->count; i ++)
+    if (workers->worker[i].fd >= 0)
+      {
+        n = write(workers->worker[i].fd, &one, sizeof one);
+        (void) n;
+      }
+  (void) pthread_mutex_unlock(&workers->mutex);
+}
+
+void *reactor_http_server_workers_thread(void *arg)
+{
+  reactor_http_server_worker *worker;
+  cpu_set_t set;
+  long cpus;
+  int e;
+
+  worker = arg;
+  if (worker->workers->flags & REACTOR_HTTP_SERVER_WORKERS_PIN)
+    {
+      cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      CPU_ZERO(&set);
+      CPU_SET(worker->index % (cpus > 0 ? cpus : 1), &set);
+      (void) pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    }
+
+  reactor_core_construct();
+  reactor_http_server_init(&worker->server, worker->workers->call, worker->workers->state);
+  reactor_stream_init(&worker->stop, reactor_http_server_workers_stop_event, worker);
+  reactor_user_dispatch(&worker->server.user, REACTOR_HTTP_SERVER_START, &worker->server);
+  e = reactor_http_server_workers_open(worker);
+  if (e == -1)
+    {
+      worker->error = 1;
+      reactor_http_server_workers_stop(worker->workers);
+    }
+  else
+    reactor_core_run();
+  reactor_http_server_workers_close(worker);
+  reactor_core_destruct();
+  return NULL;
+}
+
+int reactor_http_server_workers_open(reactor_http_server_worker *worker)
+{
+  reactor_http_server_workers *workers;
+  uint64_t one = 1;
+  size_t count;
+  ssize_t n;
+  int fd, e, stop;
+
+  workers = worker->workers;
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  e = fd == -1 ? -1 : reactor_stream_open(&worker->stop, fd);
+  if (e == -1 && fd >= 0)
+    (void) close(fd);
+
+  /* listeners join the SO_REUSEPORT group in worker order, so group index n is worker n */
+  (void) pthread_mutex_lock(&workers->mutex);
+  if (e == 0)
+    {
+      worker->fd = fd;
+      if (workers->stop)
+        {
+          n = write(fd, &one, sizeof one);
+          (void) n;
+        }
+    }
+  while (!workers->stop && workers->opened != worker->index && worker->index < workers->count)
+    (void) pthread_cond_wait(&workers->cond, &workers->mutex);
+  count = workers->count;
+  stop = workers->stop;
+  (void) pthread_mutex_unlock(&workers->mutex);
+
+  /* a worker told to stop before it opened just runs until the stop event closes it */
+  if (e == 0 && !stop)
+    {
+      e = reactor_http_server_open(&worker->server, workers->node, workers->service);
+      if (e == 0 && workers->flags & REACTOR_HTTP_SERVER_WORKERS_CBPF && worker->index == count - 1)
+        e = reactor_http_server_workers_cbpf(worker, count);
+    }
+
+  (void) pthread_mutex_lock(&workers->mutex);
+  workers->opened ++;
+  (void) pthread_cond_broadcast(&workers->cond);
+  (void) pthread_mutex_unlock(&workers->mutex);
+  return e;
+}
+
+void reactor_http_server_workers_close(reactor_http_server_worker *worker)
+{
+  (void) pthread_mutex_lock(&worker->workers->mutex);
+  worker->fd = -1;
+  (void) pthread_mutex_unlock(&worker->workers->mutex);
+  if (worker->stop.state == REACTOR_STREAM_OPEN)
+    reactor_stream_close(&worker->stop);
+
+  /* the pools of a server that did not finish closing inside the event loop are released here */
+  reactor_http_server_shutdown(&worker->server);
+  reactor_http_server_pool_clear(&worker->server.pool);
+  reactor_http_server_buffers_clear(&worker->server.buffers);
+}
+
+int reactor_http_server_workers_cbpf(reactor_http_server_worker *worker, size_t count)
+{
+  struct sock_filter code[] =
+    {
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU},
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, count},
+      {BPF_RET | BPF_A, 0, 0, 0}
+    };
+  struct sock_fprog program = {.len = sizeof code / sizeof code[0], .filter = code};
+
+  /* steer each connection to listener (cpu % count), the cpu's own worker when there is one pinned per cpu */
+  return setsockopt(reactor_desc_fd(&worker->server.tcp_server.desc), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                    &program, sizeof program);
+}
+
+void reactor_http_server_workers_stop_event(void *state, int type, void *data)
+{
+  reactor_http_server_worker *worker;
+
+  worker = state;
+  if (type != REACTOR_STREAM_DATA)
+    return;
+
+  reactor_stream_data_consume(data, ((reactor_stream_data *) data)->size);
+  (void) pthread_mutex_lock(&worker->workers->mutex);
+  worker->fd = -1;
+  (void) pthread_mutex_unlock(&worker->workers->mutex);
+  reactor_stream_close(&worker->stop);
+  reactor_http_server_shutdown(&worker->server);
+}
@@ -0,0 +1,48 @@
+#ifndef REACTOR_HTTP_SERVER_WORKERS_H_INCLUDED
+#define REACTOR_HTTP_SERVER_WORKERS_H_INCLUDED
+
+/* REACTOR_HTTP_SERVER_WORKERS_CBPF steers a connection to worker (cpu % count), where cpu received it. It is
+ * only accepted on that same cpu with REACTOR_HTTP_SERVER_WORKERS_PIN and one worker per online cpu */
+enum reactor_http_server_workers_flags
+{
+  REACTOR_HTTP_SERVER_WORKERS_PIN  = 0x01,
+  REACTOR_HTTP_SERVER_WORKERS_CBPF = 0x02
+};
+
+typedef struct reactor_http_server_workers reactor_http_server_workers;
+typedef struct reactor_http_server_worker reactor_http_server_worker;
+struct reactor_http_server_worker
+{
+  size_t                 index;
+  int                    error;
+  int                    fd;
+  reactor_stream         stop;
+  pthread_t              thread;
+  reactor_http_server_workers *workers;
+  reactor_http_server    server;
+};
+
+struct reactor_http_server_workers
+{
+  size_t                 count;
+  int                    flags;
+  char                  *node;
+  char                  *service;
+  reactor_user_call     *call;
+  void                  *state;
+  pthread_mutex_t        mutex;
+  pthread_cond_t         cond;
+  size_t                 opened;
+  int                    stop;
+  reactor_http_server_worker *worker;
+};
+
+int   reactor_http_server_workers_run(reactor_http_server_workers *, size_t, int, reactor_user_call *, void *, char *, char *);
+void  reactor_http_server_workers_stop(reactor_http_server_workers *);
+void *reactor_http_server_workers_thread(void *);
+int   reactor_http_server_workers_open(reactor_http_server_worker *);
+void  reactor_http_server_workers_close(reactor_http_server_worker *);
+int   reactor_http_server_workers_cbpf(reactor_http_server_worker *, size_t);
+void  reactor_http_server_workers_stop_event(void *, int, void *);
+
+#endif /* REACTOR_HTTP_SERVER_WORKERS_H_INCLUDED */
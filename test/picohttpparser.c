@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+
+#include "picohttpparser/picohttpparser.c"
+
+static const char *scan_ranges[] = {"\0\010\012\037\177\177", "\000\040\177\177", "::\x00\037"};
+
+static int scan_match(const char *ranges, size_t size, unsigned char c)
+{
+  size_t i;
+
+  for (i = 0; i < size; i += 2)
+    if (c >= (unsigned char) ranges[i] && c <= (unsigned char) ranges[i + 1])
+      return 1;
+  return 0;
+}
+
+#if PHR_DISPATCH
+/* a scanner may stop early without a match, but never past one and never past the end */
+static void scan_check(findchar_func scan)
+{
+  char buf[128];
+  const char *ranges, *p;
+  size_t r, size, length, position;
+  int found;
+
+  for (r = 0; r < sizeof scan_ranges / sizeof scan_ranges[0]; r ++)
+    for (length = 0; length <= 100; length ++)
+      for (position = 0; position <= length; position ++)
+        {
+          ranges = scan_ranges[r];
+          size = r == 0 ? 6 : 4;
+          memset(buf, 'a', sizeof buf);
+          if (position < length)
+            buf[position] = ranges[size - 1];
+          p = scan(buf, buf + length, ranges, size, &found);
+          assert_true(p >= buf && p <= buf + length);
+          assert_true(p <= buf + position);
+          if (found)
+            assert_true(p == buf + position && scan_match(ranges, size, *p));
+          else
+            assert_true((p - buf) % 16 == 0);
+        }
+}
+#endif
+
+static void findchar_variants(void **state)
+{
+  (void) state;
+#if PHR_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+    scan_check(findchar_sse42);
+  if (__builtin_cpu_supports("avx2"))
+    scan_check(findchar_avx2);
+#endif
+}
+
+/* more ranges than a vector scanner holds must not be scanned with only some of them */
+static void findchar_ranges_max(void **state)
+{
+  char buf[128];
+  const char *ranges = "aabbccddeeffgghhii", *p;
+  int found;
+
+  (void) state;
+  memset(buf, 'i', sizeof buf);
+  buf[40] = 'a';
+  p = findchar_scalar(buf, buf + sizeof buf, ranges, 18, &found);
+  assert_true(p == buf && !found);
+#if PHR_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    {
+      p = findchar_avx2(buf, buf + sizeof buf, ranges, 18, &found);
+      assert_true(p == buf && !found);
+    }
+#endif
+}
+
+static void parse_long_fields(void **state)
+{
+  char request[1024];
+  struct phr_header fields[4];
+  const char *method, *path;
+  size_t method_len, path_len, fields_count;
+  int minor_version, n, length;
+
+  (void) state;
+  length = snprintf(request, sizeof request, "GET /%s HTTP/1.1\r\nHost: %s\r\nX-Value: %s\r\n\r\n",
+                    "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz",
+                    "example.com.example.com.example.com",
+                    "0123456789012345678901234567890123456789\tx");
+  fields_count = 4;
+  n = phr_parse_request(request, length, &method, &method_len, &path, &path_len, &minor_version, fields, &fields_count, 0);
+  assert_int_equal(n, length);
+  assert_int_equal(fields_count, 2);
+  assert_int_equal(path_len, 53);
+  assert_int_equal(fields[1].value_len, 42);
+
+  /* a control character inside a field value ends the scan and fails the request */
+  request[length - 6] = '\001';
+  fields_count = 4;
+  n = phr_parse_request(request, length, &method, &method_len, &path, &path_len, &minor_version, fields, &fields_count, 0);
+  assert_int_equal(n, -1);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(findchar_variants),
+    cmocka_unit_test(findchar_ranges_max),
+    cmocka_unit_test(parse_long_fields)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
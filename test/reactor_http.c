@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+static void range_check(char *data, reactor_http_range *range, char *expected)
+{
+  assert_int_equal(range->size, strlen(expected));
+  assert_memory_equal(data + range->offset, expected, range->size);
+}
+
+static void url_parse(void **state)
+{
+  reactor_http_url url;
+  char full[] = "http://user:p@ss@example.com:8080/a/b?x=1&y=2#top";
+  char ipv6[] = "http://[::1]:8080/index.html";
+  char ipv6_bare[] = "https://[fe80::1]";
+  char relative[] = "/a?b#c";
+
+  (void) state;
+  assert_int_equal(reactor_http_url_parse(&url, full, strlen(full)), 0);
+  range_check(full, &url.scheme, "http");
+  range_check(full, &url.host, "example.com");
+  range_check(full, &url.port, "8080");
+  range_check(full, &url.path, "/a/b");
+  range_check(full, &url.query, "x=1&y=2");
+  range_check(full, &url.fragment, "top");
+
+  assert_int_equal(reactor_http_url_parse(&url, ipv6, strlen(ipv6)), 0);
+  range_check(ipv6, &url.host, "::1");
+  range_check(ipv6, &url.port, "8080");
+  range_check(ipv6, &url.path, "/index.html");
+
+  assert_int_equal(reactor_http_url_parse(&url, ipv6_bare, strlen(ipv6_bare)), 0);
+  range_check(ipv6_bare, &url.scheme, "https");
+  range_check(ipv6_bare, &url.host, "fe80::1");
+  assert_int_equal(url.port.size, 0);
+  assert_int_equal(url.path.size, 0);
+
+  assert_int_equal(reactor_http_url_parse(&url, relative, strlen(relative)), 0);
+  assert_int_equal(url.scheme.size, 0);
+  assert_int_equal(url.host.size, 0);
+  range_check(relative, &url.path, "/a");
+  range_check(relative, &url.query, "b");
+  range_check(relative, &url.fragment, "c");
+}
+
+static void url_parse_invalid(void **state)
+{
+  char *invalid[] = {
+    "http://[::1/",
+    "http://[::1]x/",
+    "http://host:80x/",
+    "http://host/a b",
+    "http://host/a\tb",
+    "http://host/a\001b",
+    "http://host/a\177b",
+    "http://ho\rst/"
+  };
+  reactor_http_url url;
+  size_t i;
+
+  (void) state;
+  for (i = 0; i < sizeof invalid / sizeof invalid[0]; i ++)
+    assert_int_equal(reactor_http_url_parse(&url, invalid[i], strlen(invalid[i])), -1);
+}
+
+static void url_split(void **state)
+{
+  char *cases[][4] = {
+    {"http://host/a/b?x=1#top", "host", "80", "a/b?x=1"},
+    {"http://host?q=1", "host", "80", "?q=1"},
+    {"http://host:8080?q=1#top", "host", "8080", "?q=1"},
+    {"http://host:8080", "host", "8080", ""},
+    {"http://user@host/", "host", "80", ""},
+    {"http://[::1]:8080?q", "::1", "8080", "?q"},
+    {"HTTP:///p", "localhost", "80", "p"}
+  };
+  char data[64], *host, *service, *path;
+  size_t i;
+
+  (void) state;
+  for (i = 0; i < sizeof cases / sizeof cases[0]; i ++)
+    {
+      strcpy(data, cases[i][0]);
+      assert_int_equal(reactor_http_split_url(data, &host, &service, &path), 0);
+      assert_string_equal(host, cases[i][1]);
+      assert_string_equal(service, cases[i][2]);
+      assert_string_equal(path, cases[i][3]);
+    }
+
+  strcpy(data, "ftp://host/");
+  assert_int_equal(reactor_http_split_url(data, &host, &service, &path), -1);
+}
+
+static void url_decode(void **state)
+{
+  char to[32];
+  ssize_t n;
+
+  (void) state;
+  n = reactor_http_url_decode(to, "a%20b%2e%2E%2f", 14);
+  assert_int_equal(n, 6);
+  assert_memory_equal(to, "a b../", 6);
+  n = reactor_http_url_decode(to, "plain", 5);
+  assert_int_equal(n, 5);
+  assert_memory_equal(to, "plain", 5);
+  assert_int_equal(reactor_http_url_decode(to, "a%2", 3), -1);
+  assert_int_equal(reactor_http_url_decode(to, "a%zz", 4), -1);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(url_parse),
+    cmocka_unit_test(url_parse_invalid),
+    cmocka_unit_test(url_split),
+    cmocka_unit_test(url_decode)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+typedef struct pipeline pipeline;
+struct pipeline
+{
+  size_t                 responses;
+  int                    status[4];
+  char                  *state[4];
+};
+
+static void pipeline_event(void *state, int type, void *data)
+{
+  pipeline *p;
+  reactor_http_client_exchange *exchange;
+
+  p = state;
+  assert_int_equal(type, REACTOR_HTTP_CLIENT_PIPELINE_RESPONSE);
+  exchange = data;
+  assert_non_null(exchange->response);
+  assert_true(p->responses < 4);
+  p->status[p->responses] = exchange->response->status;
+  p->state[p->responses] = exchange->state;
+  p->responses ++;
+}
+
+static void pipeline_responses(void **state)
+{
+  reactor_http_client client;
+  reactor_stream_data data;
+  pipeline p = {0};
+  char input[] =
+    "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nfirst"
+    "HTTP/1.1 404 Not Found\r\nContent-Length: 6\r\n\r\nsecond";
+
+  (void) state;
+  reactor_http_client_init(&client, pipeline_event, &p);
+  client.host = "localhost";
+  client.service = "80";
+  client.depth = 2;
+  client.state = REACTOR_HTTP_CLIENT_CONNECTING;
+  reactor_http_parser_open_response(&client.parser, &client.response, 0);
+  assert_int_equal(reactor_http_client_pipeline_request(&client, "GET", "/a", NULL, 0, "a"), 0);
+  assert_int_equal(reactor_http_client_pipeline_request(&client, "GET", "/b", NULL, 0, "b"), 0);
+  client.state = REACTOR_HTTP_CLIENT_CONNECTED;
+
+  /* both responses arrive in a single read */
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_client_stream_event(&client, REACTOR_STREAM_DATA, &data);
+  assert_int_equal(p.responses, 2);
+  assert_int_equal(p.status[0], 200);
+  assert_string_equal(p.state[0], "a");
+  assert_int_equal(p.status[1], 404);
+  assert_string_equal(p.state[1], "b");
+  assert_int_equal(data.size, 0);
+
+  vector_clear(&client.exchanges);
+  reactor_http_parser_close(&client.parser);
+  reactor_http_request_clear(&client.request);
+  reactor_http_response_clear(&client.response);
+}
+
+/* the uri is kept whole next to the host, service and request target split from it */
+static void client_target(void **state)
+{
+  reactor_http_client client;
+  char *path;
+  size_t capacity;
+
+  (void) state;
+  reactor_http_client_init(&client, NULL, NULL);
+  assert_int_equal(reactor_http_client_target(&client, "http://host:8080?q=1#top", &path), 0);
+  assert_string_equal(buffer_data(&client.uri), "http://host:8080?q=1#top");
+  assert_string_equal(client.host, "host");
+  assert_string_equal(client.service, "8080");
+  assert_string_equal(path, "?q=1");
+
+  capacity = buffer_capacity(&client.uri);
+  assert_int_equal(reactor_http_client_target(&client, "http://other/p?x", &path), 0);
+  assert_int_equal(buffer_capacity(&client.uri), capacity);
+  assert_string_equal(buffer_data(&client.uri), "http://other/p?x");
+  assert_string_equal(client.host, "other");
+  assert_string_equal(client.service, "80");
+  assert_string_equal(path, "p?x");
+
+  assert_int_equal(reactor_http_client_target(&client, "ftp://host/", &path), -1);
+  buffer_clear(&client.uri);
+}
+
+typedef struct pooled pooled;
+struct pooled
+{
+  size_t                 responses;
+  size_t                 closes;
+  size_t                 errors;
+  int                    status;
+};
+
+static void pooled_event(void *state, int type, void *data)
+{
+  pooled *p;
+
+  p = state;
+  switch (type)
+    {
+    case REACTOR_HTTP_CLIENT_RESPONSE:
+      p->responses ++;
+      p->status = ((reactor_http_response *) data)->status;
+      break;
+    case REACTOR_HTTP_CLIENT_CLOSE:
+      p->closes ++;
+      break;
+    case REACTOR_HTTP_CLIENT_ERROR:
+      p->errors ++;
+      break;
+    }
+}
+
+/* send a request through the pool and answer it from the peer */
+static void pooled_exchange(reactor_http_client_pool *pool, reactor_http_client *client, int fd, pooled *p,
+                            char *uri, char *response)
+{
+  reactor_stream_data data;
+  char input[1024];
+  ssize_t n;
+
+  assert_int_equal(reactor_http_client_pool_request(pool, pooled_event, p, "GET", uri, NULL, 0, 0), 0);
+  n = read(fd, input, sizeof input - 1);
+  assert_true(n > 0);
+  input[n] = '\0';
+  assert_non_null(strstr(input, "Connection: keep-alive\r\n"));
+  assert_true(client->reused);
+
+  /* the parser writes into its input */
+  strcpy(input, response);
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_client_stream_event(client, REACTOR_STREAM_DATA, &data);
+}
+
+/* a connection is reused after an HTTP/1.1 response and closed after an HTTP/1.0 one */
+static void pool_reuse(void **state)
+{
+  reactor_http_client_pool pool;
+  reactor_http_client *client;
+  pooled p = {0};
+  char output[16];
+  int fd[2];
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_client_pool_init(&pool);
+  pool.state = REACTOR_HTTP_CLIENT_POOL_OPEN;
+  pool.now = time(NULL);
+
+  /* an idle connection to 127.0.0.1:80, as left behind by an earlier request */
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd), 0);
+  client = malloc(sizeof *client);
+  assert_non_null(client);
+  reactor_http_client_init(client, reactor_http_client_pool_client_event, &pool);
+  client->pool = &pool;
+  client->key = reactor_http_client_pool_key("http://127.0.0.1/");
+  assert_string_equal(client->key, "127.0.0.1:80");
+  assert_int_equal(reactor_stream_open(&client->stream, fd[0]), 0);
+  client->state = REACTOR_HTTP_CLIENT_IDLE;
+  assert_int_equal(vector_push_back(&pool.idle, &client), 0);
+  pool.clients = 1;
+
+  pooled_exchange(&pool, client, fd[1], &p, "http://127.0.0.1/a", "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok");
+  assert_int_equal(p.responses, 1);
+  assert_int_equal(p.status, 200);
+  assert_int_equal(client->state, REACTOR_HTTP_CLIENT_IDLE);
+  assert_int_equal(vector_size(&pool.idle), 1);
+  assert_int_equal(pool.hits, 1);
+
+  pooled_exchange(&pool, client, fd[1], &p, "http://127.0.0.1/b", "HTTP/1.0 200 OK\r\nContent-Length: 2\r\n\r\nok");
+  assert_int_equal(p.responses, 2);
+  assert_int_equal(pool.hits, 2);
+  assert_int_equal(pool.misses, 0);
+  assert_int_equal(reactor_core_run(), 0);
+  assert_int_equal(vector_size(&pool.idle), 0);
+  assert_int_equal(vector_size(&pool.closed), 1);
+  assert_int_equal(pool.clients, 0);
+  assert_int_equal(read(fd[1], output, sizeof output), 0);
+  assert_int_equal(p.closes, 2);
+  assert_int_equal(p.errors, 0);
+
+  reactor_http_client_pool_reap(&pool);
+  assert_int_equal(vector_size(&pool.closed), 0);
+  vector_clear(&pool.idle);
+  vector_clear(&pool.closed);
+  (void) close(fd[1]);
+  reactor_core_destruct();
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(pipeline_responses),
+    cmocka_unit_test(client_target),
+    cmocka_unit_test(pool_reuse)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
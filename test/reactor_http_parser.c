@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+typedef struct events events;
+struct events
+{
+  size_t                 errors;
+  size_t                 done;
+};
+
+static void parser_event(void *state, int type, void *data)
+{
+  events *e;
+
+  (void) data;
+  e = state;
+  if (type == REACTOR_HTTP_PARSER_ERROR)
+    e->errors ++;
+  if (type == REACTOR_HTTP_PARSER_DONE)
+    e->done ++;
+}
+
+/* feed the input as a stream would, one more byte for every read, keeping what the parser did not consume */
+static size_t feed(reactor_http_parser *parser, events *e, char *input, size_t size)
+{
+  reactor_stream_data data;
+  size_t i, consumed;
+
+  for (consumed = 0, i = 1; i <= size && !e->done; i ++)
+    {
+      data = (reactor_stream_data) {.base = input + consumed, .size = i - consumed};
+      reactor_http_parser_data(parser, &data);
+      assert_int_equal(e->errors, 0);
+      consumed = i - data.size;
+      if (!e->done && parser->state == REACTOR_HTTP_PARSER_REQUEST_HEADER)
+        assert_int_equal(parser->header_checked, i - consumed);
+    }
+  return i - 1;
+}
+
+static void header_byte_at_a_time(void **state)
+{
+  reactor_http_parser parser;
+  reactor_http_request request;
+  events e = {0};
+  char input[] = "POST /path HTTP/1.1\r\nHost: localhost\r\nContent-Length: 5\r\n\r\nhello";
+  char *value;
+  size_t size;
+
+  (void) state;
+  reactor_http_parser_init(&parser, parser_event, &e);
+  reactor_http_request_init(&request);
+  reactor_http_parser_open_request(&parser, &request, 0);
+
+  size = feed(&parser, &e, input, sizeof input - 1);
+  assert_int_equal(e.done, 1);
+  assert_int_equal(size, sizeof input - 1);
+  assert_string_equal(request.method, "POST");
+  assert_string_equal(request.path, "/path");
+  assert_string_equal(reactor_http_field_lookup(&request.fields, "host"), "localhost");
+  value = reactor_http_request_field(&request, "Host", &size);
+  assert_non_null(value);
+  assert_int_equal(size, 9);
+  assert_memory_equal(value, "localhost", 9);
+  value = reactor_http_request_field_id(&request, REACTOR_HTTP_FIELD_CONTENT_LENGTH, &size);
+  assert_non_null(value);
+  assert_int_equal(size, 1);
+  assert_memory_equal(value, "5", 1);
+  assert_int_equal(request.content_size, 5);
+  assert_memory_equal(request.content, "hello", 5);
+
+  reactor_http_parser_close(&parser);
+  reactor_http_request_clear(&request);
+}
+
+static void chunked_byte_at_a_time(void **state)
+{
+  reactor_http_parser parser;
+  reactor_http_request request;
+  events e = {0};
+  char input[] = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;x=y\r\nhello\r\n6\r\n world\r\n0\r\nA: b\r\n\r\n";
+  char *value;
+  size_t size;
+
+  (void) state;
+  reactor_http_parser_init(&parser, parser_event, &e);
+  reactor_http_request_init(&request);
+  reactor_http_parser_open_request(&parser, &request, REACTOR_HTTP_PARSER_FLAGS_RANGES);
+
+  size = feed(&parser, &e, input, sizeof input - 1);
+  assert_int_equal(e.done, 1);
+  assert_int_equal(size, sizeof input - 1);
+  assert_int_equal(request.content_size, 11);
+  assert_memory_equal(request.content, "hello world", 11);
+  value = reactor_http_request_field(&request, "transfer-encoding", &size);
+  assert_non_null(value);
+  assert_int_equal(size, 7);
+  assert_memory_equal(value, "chunked", 7);
+  value = reactor_http_request_field_id(&request, REACTOR_HTTP_FIELD_TRANSFER_ENCODING, &size);
+  assert_non_null(value);
+  assert_int_equal(size, 7);
+  assert_memory_equal(value, "chunked", 7);
+  assert_null(reactor_http_request_field_id(&request, REACTOR_HTTP_FIELD_CONTENT_LENGTH, &size));
+
+  reactor_http_parser_close(&parser);
+  reactor_http_request_clear(&request);
+}
+
+/* parse the input in one read and return the status it was rejected with, or 0 if the request completed */
+static unsigned parse_status(char *input, size_t size, size_t fields)
+{
+  reactor_http_parser parser;
+  reactor_http_request request;
+  reactor_stream_data data;
+  events e = {0};
+  unsigned status;
+
+  reactor_http_parser_init(&parser, parser_event, &e);
+  reactor_http_request_init(&request);
+  reactor_http_parser_open_request(&parser, &request, 0);
+  reactor_http_parser_limits(&parser, 0, fields, 0, 0);
+  data = (reactor_stream_data) {.base = input, .size = size};
+  reactor_http_parser_data(&parser, &data);
+  status = parser.status;
+  assert_true(status ? e.errors == 1 && e.done == 0 : e.errors == 0 && e.done == 1);
+
+  reactor_http_parser_close(&parser);
+  reactor_http_request_clear(&request);
+  return status;
+}
+
+static void chunked_size_syntax(void **state)
+{
+  char valid[][128] = {
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 \t;x=y\r\nhello\r\n0\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\nhello\r\n0\n\r\n"
+  };
+  char invalid[][128] = {
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0x5\r\nhello\r\n0\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5xyz\r\nhello\r\n0\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 5\r\nhello\r\n0\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\rx\nhello\r\n0\r\n\r\n"
+  };
+  size_t i;
+
+  (void) state;
+  for (i = 0; i < sizeof valid / sizeof valid[0]; i ++)
+    assert_int_equal(parse_status(valid[i], strlen(valid[i]), 0), 0);
+  for (i = 0; i < sizeof invalid / sizeof invalid[0]; i ++)
+    assert_int_equal(parse_status(invalid[i], strlen(invalid[i]), 0), 400);
+}
+
+/* only a request with more fields than allowed is answered with 431, a malformed one with 400 */
+static void header_fields_limit(void **state)
+{
+  char fit[] = "GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\n\r\n";
+  char over[] = "GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n";
+  char malformed_first[] = "GET / HTTP/1.1\r\nA 1\r\nB: 2\r\nC: 3\r\n\r\n";
+  char malformed_last[] = "GET / HTTP/1.1\r\nA: 1\r\nB 2\r\n\r\n";
+  char malformed_end[] = "GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\n\rX\r\n\r\n";
+
+  (void) state;
+  assert_int_equal(parse_status(fit, sizeof fit - 1, 2), 0);
+  assert_int_equal(parse_status(over, sizeof over - 1, 2), 431);
+  assert_int_equal(parse_status(malformed_first, sizeof malformed_first - 1, 2), 400);
+  assert_int_equal(parse_status(malformed_last, sizeof malformed_last - 1, 2), 400);
+  assert_int_equal(parse_status(malformed_end, sizeof malformed_end - 1, 2), 400);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(header_byte_at_a_time),
+    cmocka_unit_test(chunked_byte_at_a_time),
+    cmocka_unit_test(chunked_size_syntax),
+    cmocka_unit_test(header_fields_limit)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
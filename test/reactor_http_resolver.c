@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+typedef struct lookups lookups;
+struct lookups
+{
+  reactor_http_resolver  resolver;
+  reactor_http_resolver_result result;
+  size_t                 results;
+  size_t                 errors;
+};
+
+static size_t fake_calls = 0;
+static pthread_mutex_t fake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fake_cond = PTHREAD_COND_INITIALIZER;
+static int fake_hold = 0;
+
+static int fake_resolve(char *host, char *address, size_t size)
+{
+  (void) pthread_mutex_lock(&fake_mutex);
+  fake_calls ++;
+  while (fake_hold)
+    (void) pthread_cond_wait(&fake_cond, &fake_mutex);
+  (void) pthread_mutex_unlock(&fake_mutex);
+
+  if (strcmp(host, "backend") != 0)
+    return EAI_NONAME;
+  (void) snprintf(address, size, "10.0.0.1");
+  return 0;
+}
+
+static void fake_event(void *state, int type, void *data)
+{
+  lookups *l;
+  reactor_http_resolver_result *result, cached;
+
+  l = state;
+  result = data;
+  if (type == REACTOR_HTTP_RESOLVER_RESULT)
+    {
+      l->results ++;
+      assert_string_equal(result->host, "backend");
+      assert_string_equal(result->address, "10.0.0.1");
+
+      /* the answer is cached before it is dispatched */
+      assert_int_equal(reactor_http_resolver_lookup(&l->resolver, "backend", &cached, fake_event, l), 1);
+      assert_int_equal(cached.error, 0);
+      assert_string_equal(cached.address, "10.0.0.1");
+      assert_int_equal(reactor_http_resolver_lookup(&l->resolver, "missing", &l->result, fake_event, l), 0);
+    }
+  else
+    {
+      l->errors ++;
+      assert_string_equal(result->host, "missing");
+      assert_int_equal(reactor_http_resolver_lookup(&l->resolver, "missing", &cached, fake_event, l), 1);
+      assert_int_not_equal(cached.error, 0);
+      reactor_http_resolver_close(&l->resolver);
+    }
+}
+
+static void resolver_fake(void **state)
+{
+  lookups l = {0};
+
+  (void) state;
+  fake_calls = 0;
+  reactor_core_construct();
+  reactor_http_resolver_init(&l.resolver);
+  reactor_http_resolver_function(&l.resolver, fake_resolve);
+  assert_int_equal(reactor_http_resolver_open(&l.resolver), 0);
+  assert_int_equal(reactor_http_resolver_lookup(&l.resolver, "backend", &l.result, fake_event, &l), 0);
+  assert_int_equal(reactor_core_run(), 0);
+  reactor_core_destruct();
+
+  assert_int_equal(l.results, 1);
+  assert_int_equal(l.errors, 1);
+  assert_int_equal(fake_calls, 2);
+  assert_int_equal(l.resolver.hits, 2);
+  assert_int_equal(l.resolver.misses, 2);
+}
+
+static void hosts_event(void *state, int type, void *data)
+{
+  lookups *l;
+  reactor_http_resolver_result *result;
+
+  l = state;
+  result = data;
+  assert_int_equal(type, REACTOR_HTTP_RESOLVER_RESULT);
+  assert_true(strcmp(result->address, "127.0.0.1") == 0 || strcmp(result->address, "::1") == 0);
+  l->results ++;
+  reactor_http_resolver_close(&l->resolver);
+}
+
+static void resolver_hosts(void **state)
+{
+  lookups l = {0};
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_resolver_init(&l.resolver);
+  assert_int_equal(reactor_http_resolver_open(&l.resolver), 0);
+  assert_int_equal(reactor_http_resolver_lookup(&l.resolver, "localhost", &l.result, hosts_event, &l), 0);
+  assert_int_equal(reactor_core_run(), 0);
+  reactor_core_destruct();
+
+  assert_int_equal(l.results, 1);
+}
+
+static void resolver_close_pending(void **state)
+{
+  lookups l = {0};
+  size_t calls;
+
+  (void) state;
+  fake_calls = 0;
+  fake_hold = 1;
+  reactor_core_construct();
+  reactor_http_resolver_init(&l.resolver);
+  reactor_http_resolver_function(&l.resolver, fake_resolve);
+  assert_int_equal(reactor_http_resolver_open(&l.resolver), 0);
+  assert_int_equal(reactor_http_resolver_lookup(&l.resolver, "backend", &l.result, fake_event, &l), 0);
+  assert_int_equal(reactor_http_resolver_lookup(&l.resolver, "queued", &l.result, fake_event, &l), 0);
+  do
+    {
+      (void) pthread_mutex_lock(&fake_mutex);
+      calls = fake_calls;
+      (void) pthread_mutex_unlock(&fake_mutex);
+    }
+  while (!calls);
+
+  /* the lookup in progress is still held, closing must not wait for it */
+  reactor_http_resolver_close(&l.resolver);
+  assert_int_equal(reactor_core_run(), 0);
+  reactor_core_destruct();
+
+  (void) pthread_mutex_lock(&fake_mutex);
+  fake_hold = 0;
+  (void) pthread_cond_signal(&fake_cond);
+  (void) pthread_mutex_unlock(&fake_mutex);
+  assert_int_equal(l.results, 0);
+  assert_int_equal(l.errors, 0);
+  assert_int_equal(fake_calls, 1);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(resolver_fake),
+    cmocka_unit_test(resolver_hosts),
+    cmocka_unit_test(resolver_close_pending)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
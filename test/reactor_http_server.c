@@ -0,0 +1,939 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+extern int debug_out_of_memory;
+
+static void server_event(void *state, int type, void *data)
+{
+  (void) data;
+  if (type == REACTOR_HTTP_SERVER_ERROR)
+    (*(size_t *) state) ++;
+}
+
+/* respond twice with the same fields, the second response must reuse the storage the first one left */
+static void respond_twice(reactor_http_field *fields, size_t nfields)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  buffer first;
+  size_t errors = 0;
+
+  reactor_http_server_init(&server, server_event, &errors);
+  reactor_http_server_name(&server, "test");
+  reactor_http_server_date_update(&server);
+  session = malloc(sizeof *session);
+  assert_non_null(session);
+  reactor_http_server_session_init(session, &server);
+  session->cork = 1;
+  session->requests = 2;
+
+  reactor_http_server_session_respond_fields(session, 200, "text/plain", "hello", 5, fields, nfields);
+  assert_int_equal(errors, 0);
+  buffer_init(&first);
+  assert_int_equal(buffer_insert(&first, 0, buffer_data(&session->stream.output), buffer_size(&session->stream.output)), 0);
+  buffer_erase(&session->stream.output, 0, buffer_size(&session->stream.output));
+
+  debug_out_of_memory = 1;
+  reactor_http_server_session_respond_fields(session, 200, "text/plain", "hello", 5, fields, nfields);
+  debug_out_of_memory = 0;
+  assert_int_equal(errors, 0);
+  assert_int_equal(buffer_size(&session->stream.output), buffer_size(&first));
+  assert_memory_equal(buffer_data(&session->stream.output), buffer_data(&first), buffer_size(&first));
+  assert_memory_equal(buffer_data(&first), "HTTP/1.1 200 OK\r\n", 17);
+
+  buffer_clear(&first);
+  reactor_http_server_session_free(session);
+}
+
+static void respond_no_allocation(void **state)
+{
+  (void) state;
+  respond_twice((reactor_http_field[]) {{.key = "Cache-Control", .value = "no-cache"}}, 1);
+}
+
+static void respond_overflow_no_allocation(void **state)
+{
+  char value[REACTOR_HTTP_BUILDER_SIZE];
+
+  (void) state;
+  memset(value, 'x', sizeof value - 1);
+  value[sizeof value - 1] = '\0';
+  respond_twice((reactor_http_field[]) {{.key = "X-Large", .value = value}}, 1);
+}
+
+/* cached and uncached statuses must produce the same status line, Server and Date fields */
+static void respond_prefix(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  unsigned status[] = {200, 404, 503, 418};
+  char expected[256];
+  size_t errors = 0, i;
+  int n;
+
+  (void) state;
+  reactor_http_server_init(&server, server_event, &errors);
+  reactor_http_server_name(&server, "test");
+  reactor_http_server_date_update(&server);
+  assert_non_null(reactor_http_server_prefix_lookup(&server, 200));
+  assert_null(reactor_http_server_prefix_lookup(&server, 418));
+  session = malloc(sizeof *session);
+  assert_non_null(session);
+  reactor_http_server_session_init(session, &server);
+  session->cork = 1;
+  session->requests = 4;
+
+  for (i = 0; i < sizeof status / sizeof status[0]; i ++)
+    {
+      reactor_http_server_session_respond(session, status[i], NULL, NULL, 0);
+      n = snprintf(expected, sizeof expected, "HTTP/1.1 %u %s\r\nServer: test\r\nDate: %s\r\nContent-Length: 0\r\n\r\n",
+                   status[i], reactor_http_status_message(status[i]), server.date);
+      assert_int_equal(buffer_size(&session->stream.output), n);
+      assert_memory_equal(buffer_data(&session->stream.output), expected, n);
+      buffer_erase(&session->stream.output, 0, buffer_size(&session->stream.output));
+    }
+  assert_int_equal(errors, 0);
+
+  reactor_http_server_session_free(session);
+}
+
+static void respond_event(void *state, int type, void *data)
+{
+  reactor_http_server_batch *batch;
+  size_t i;
+
+  if (type == REACTOR_HTTP_SERVER_ERROR)
+    (*(size_t *) state) ++;
+  if (type == REACTOR_HTTP_SERVER_REQUEST)
+    reactor_http_server_session_respond(data, 200, "text/plain", "ok", 2);
+  if (type == REACTOR_HTTP_SERVER_REQUEST_BATCH)
+    {
+      batch = data;
+      for (i = 0; i < batch->count; i ++)
+        reactor_http_server_session_respond(batch->session, 200, "text/plain", "ok", 2);
+    }
+}
+
+/* feed the requests in one read and return what the peer received */
+static size_t session_exchange(reactor_http_server *server, char *input, char *output, size_t size)
+{
+  reactor_http_server_session *session;
+  reactor_stream_data data;
+  char buffer[4096];
+  ssize_t n;
+  int fd[2];
+
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd), 0);
+  session = reactor_http_server_pool_get(server);
+  assert_non_null(session);
+  assert_int_equal(reactor_http_server_session_open(session, fd[0]), 0);
+
+  /* the parser writes into its input */
+  assert_true(strlen(input) < sizeof buffer);
+  strcpy(buffer, input);
+  data = (reactor_stream_data) {.base = buffer, .size = strlen(buffer)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &data);
+  n = read(fd[1], output, size - 1);
+  assert_true(n > 0);
+  output[n] = '\0';
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  return n;
+}
+
+/* each pipelined response carries the version and persistence of its own request */
+static void pipeline_versions(void **state)
+{
+  reactor_http_server server;
+  char output[4096], *first, *second, *third;
+  size_t errors = 0;
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_server_init(&server, respond_event, &errors);
+  reactor_http_server_flags(&server, REACTOR_HTTP_SERVER_FLAGS_BATCH);
+  reactor_http_server_date_update(&server);
+  (void) session_exchange(&server,
+                          "GET /a HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"
+                          "GET /b HTTP/1.1\r\n\r\n"
+                          "GET /c HTTP/1.1\r\nConnection: close\r\n\r\n",
+                          output, sizeof output);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+
+  assert_int_equal(errors, 0);
+  first = strstr(output, "HTTP/1.1 200 OK");
+  assert_non_null(first);
+  second = strstr(first + 1, "HTTP/1.1 200 OK");
+  assert_non_null(second);
+  third = strstr(second + 1, "HTTP/1.1 200 OK");
+  assert_non_null(third);
+  assert_null(strstr(third + 1, "HTTP/1.1 200 OK"));
+
+  *second = *third = '\0';
+  assert_non_null(strstr(first, "Connection: keep-alive\r\n"));
+  assert_null(strstr(first, "Connection: close\r\n"));
+  assert_null(strstr(second + 1, "Connection:"));
+  assert_non_null(strstr(third + 1, "Connection: close\r\n"));
+}
+
+/* responses to requests read together leave in one write */
+static void pipeline_corked(void **state)
+{
+  reactor_http_server server;
+  char output[4096], *p;
+  size_t errors = 0, responses;
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_server_init(&server, respond_event, &errors);
+  reactor_http_server_date_update(&server);
+  (void) session_exchange(&server, "GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\nGET /c HTTP/1.1\r\n\r\n",
+                          output, sizeof output);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+
+  assert_int_equal(errors, 0);
+  assert_int_equal(server.requests, 3);
+  assert_int_equal(server.writes, 1);
+  for (responses = 0, p = output; (p = strstr(p, "HTTP/1.1 200 OK")); p ++)
+    responses ++;
+  assert_int_equal(responses, 3);
+}
+
+/* an idle session gives its buffers back and takes ones of the sizes it used on the next read */
+static void reclaim_buffers(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  reactor_stream_data data;
+  buffer small;
+  char input[64], output[4096];
+  size_t errors = 0, capacity, input_capacity;
+  int fd[2];
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_server_init(&server, respond_event, &errors);
+  reactor_http_server_date_update(&server);
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd), 0);
+  session = reactor_http_server_pool_get(&server);
+  assert_non_null(session);
+  assert_int_equal(reactor_http_server_session_open(session, fd[0]), 0);
+
+  assert_int_equal(buffer_reserve(&session->stream.input, 2 * REACTOR_HTTP_SERVER_BUFFERS_MIN), 0);
+  input_capacity = buffer_capacity(&session->stream.input);
+  assert_int_equal(buffer_reserve(&session->stream.output, 5 * REACTOR_HTTP_SERVER_BUFFERS_MIN), 0);
+  capacity = buffer_capacity(&session->stream.output);
+  reactor_http_server_session_reclaim(session);
+  assert_int_equal(buffer_capacity(&session->stream.input), 0);
+  assert_int_equal(buffer_capacity(&session->stream.output), 0);
+  assert_int_equal(session->input_capacity, input_capacity);
+  assert_int_equal(session->output_capacity, capacity);
+
+  /* a smaller pooled buffer must not be handed out instead */
+  buffer_init(&small);
+  assert_int_equal(buffer_reserve(&small, REACTOR_HTTP_SERVER_BUFFERS_MIN), 0);
+  reactor_http_server_buffers_put(&server.buffers, &small);
+
+  strcpy(input, "GET / HTTP/1.1\r\n\r\n");
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &data);
+  assert_true(read(fd[1], output, sizeof output) > 0);
+  assert_int_equal(buffer_capacity(&session->stream.input), input_capacity);
+  assert_int_equal(buffer_capacity(&session->stream.output), capacity);
+  assert_int_equal(server.buffers.hits, 2);
+  assert_int_equal(server.buffers.misses, 0);
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(errors, 0);
+}
+
+typedef struct transfer transfer;
+struct transfer
+{
+  size_t                 errors;
+  char                  *body;
+  size_t                 size;
+  size_t                 released;
+  void                  *released_base;
+};
+
+static void transfer_release(void *state, int type, void *data)
+{
+  transfer *t;
+
+  t = state;
+  if (type == REACTOR_HTTP_SERVER_RELEASE)
+    {
+      t->released ++;
+      t->released_base = data;
+    }
+}
+
+static void transfer_event(void *state, int type, void *data)
+{
+  transfer *t;
+
+  t = state;
+  if (type == REACTOR_HTTP_SERVER_ERROR)
+    t->errors ++;
+  if (type == REACTOR_HTTP_SERVER_REQUEST)
+    reactor_http_server_session_respond_reference(data, 200, "application/octet-stream", t->body, t->size,
+                                                  NULL, 0, transfer_release, t);
+}
+
+/* open a session on one end of a socketpair with small socket buffers, so large responses only leave in parts */
+static reactor_http_server_session *session_connect(reactor_http_server *server, int fd[2])
+{
+  reactor_http_server_session *session;
+  int size = 4096;
+
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd), 0);
+  assert_int_equal(setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof size), 0);
+  assert_int_equal(setsockopt(fd[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof size), 0);
+  session = reactor_http_server_pool_get(server);
+  assert_non_null(session);
+  assert_int_equal(reactor_http_server_session_open(session, fd[0]), 0);
+  return session;
+}
+
+/* read what the peer can get, telling the session the socket is writable again whenever nothing is pending */
+static size_t session_receive(reactor_http_server_session *session, int fd, char *output, size_t size, size_t expected)
+{
+  size_t received, rounds;
+  ssize_t n;
+
+  for (received = 0, rounds = 0; received < expected && rounds < 100000; rounds ++)
+    {
+      n = read(fd, output + received, size - received);
+      if (n > 0)
+        received += n;
+      else
+        reactor_http_server_session_stream_event(session, REACTOR_STREAM_WRITE_AVAILABLE, NULL);
+    }
+  return received;
+}
+
+/* a referenced body larger than the socket buffer is sent over several writes and released once, after the last byte */
+static void reference_partial_write(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  reactor_stream_data data;
+  transfer t = {0};
+  char input[64], *output, *body;
+  size_t i, received, header;
+  int fd[2];
+
+  (void) state;
+  t.size = 1048576;
+  t.body = malloc(t.size);
+  output = malloc(t.size + 4096);
+  assert_non_null(t.body);
+  assert_non_null(output);
+  for (i = 0; i < t.size; i ++)
+    t.body[i] = 'a' + i % 26;
+
+  reactor_core_construct();
+  reactor_http_server_init(&server, transfer_event, &t);
+  reactor_http_server_date_update(&server);
+  session = session_connect(&server, fd);
+  strcpy(input, "GET / HTTP/1.1\r\n\r\n");
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &data);
+
+  /* the socket filled up, the body is still referenced */
+  assert_int_equal(t.released, 0);
+  assert_true(vector_size(&session->segments) > 0);
+
+  received = session_receive(session, fd[1], output, t.size + 4095, t.size + 1);
+  output[received] = '\0';
+  body = strstr(output, "\r\n\r\n");
+  assert_non_null(body);
+  body += 4;
+  header = body - output;
+  assert_int_equal(received, header + t.size);
+  assert_memory_equal(body, t.body, t.size);
+  assert_int_equal(t.released, 1);
+  assert_true(t.released_base == t.body);
+  assert_true(server.writes > 1);
+  assert_int_equal(vector_size(&session->segments), 0);
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(t.errors, 0);
+  assert_int_equal(t.released, 1);
+  free(t.body);
+  free(output);
+}
+
+typedef struct producer producer;
+struct producer
+{
+  size_t                 errors;
+  size_t                 drains;
+  size_t                 blocked;
+  size_t                 sent;
+  size_t                 size;
+};
+
+static void producer_fill(producer *p, reactor_http_server_session *session)
+{
+  char chunk[8192];
+  size_t i, n;
+
+  while (p->sent < p->size)
+    {
+      if (reactor_http_server_session_blocked(session))
+        {
+          p->blocked ++;
+          return;
+        }
+      n = p->size - p->sent < sizeof chunk ? p->size - p->sent : sizeof chunk;
+      for (i = 0; i < n; i ++)
+        chunk[i] = 'a' + (p->sent + i) % 26;
+      assert_int_equal(reactor_http_server_session_respond_chunk(session, chunk, n), 0);
+      p->sent += n;
+    }
+  assert_int_equal(reactor_http_server_session_respond_end(session), 0);
+}
+
+static void producer_event(void *state, int type, void *data)
+{
+  producer *p;
+
+  p = state;
+  switch (type)
+    {
+    case REACTOR_HTTP_SERVER_ERROR:
+      p->errors ++;
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST:
+      reactor_http_server_session_respond_begin(data, 200, "text/plain", NULL, 0);
+      producer_fill(p, data);
+      break;
+    case REACTOR_HTTP_SERVER_DRAIN:
+      p->drains ++;
+      producer_fill(p, data);
+      break;
+    }
+}
+
+/* a producer stopping at the high water mark is resumed by a drain event until the whole stream is out */
+static void stream_drain(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  reactor_stream_data data;
+  producer p = {.size = 1048576};
+  char input[64], *output, *body, *end;
+  size_t i, received, size, decoded;
+  int fd[2];
+
+  (void) state;
+  output = malloc(2 * p.size);
+  assert_non_null(output);
+  reactor_core_construct();
+  reactor_http_server_init(&server, producer_event, &p);
+  reactor_http_server_date_update(&server);
+  session = session_connect(&server, fd);
+  strcpy(input, "GET / HTTP/1.1\r\n\r\n");
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &data);
+  assert_int_equal(p.blocked, 1);
+  assert_true(p.sent < p.size);
+
+  for (received = 0;;)
+    {
+      received += session_receive(session, fd[1], output + received, 2 * p.size - 1 - received, 1);
+      output[received] = '\0';
+      if (received >= 5 && memcmp(output + received - 5, "0\r\n\r\n", 5) == 0)
+        break;
+    }
+  assert_int_equal(p.sent, p.size);
+  assert_true(p.drains >= 1);
+  assert_int_equal(p.drains, p.blocked);
+
+  body = strstr(output, "\r\n\r\n");
+  assert_non_null(body);
+  assert_non_null(strstr(output, "Transfer-Encoding: chunked\r\n"));
+  body += 4;
+  for (decoded = 0;; body = end + 2 + size + 2)
+    {
+      size = strtoul(body, &end, 16);
+      assert_memory_equal(end, "\r\n", 2);
+      if (!size)
+        break;
+      for (i = 0; i < size; i ++)
+        assert_int_equal(end[2 + i], 'a' + (decoded + i) % 26);
+      decoded += size;
+      assert_memory_equal(end + 2 + size, "\r\n", 2);
+    }
+  assert_int_equal(decoded, p.size);
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(p.errors, 0);
+  free(output);
+}
+
+/* pass input to the session the way the stream does, keeping what was left unconsumed for the next read */
+static void session_feed(reactor_http_server_session *session, buffer *input, char *data, size_t size)
+{
+  reactor_stream_data stream_data;
+
+  assert_int_equal(buffer_insert(input, buffer_size(input), data, size), 0);
+  stream_data = (reactor_stream_data) {.base = buffer_data(input), .size = buffer_size(input)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &stream_data);
+  buffer_erase(input, 0, buffer_size(input) - stream_data.size);
+}
+
+typedef struct upload upload;
+struct upload
+{
+  size_t                 errors;
+  size_t                 requests;
+  char                  *body;
+  size_t                 size;
+  int                    spilled;
+};
+
+static void upload_event(void *state, int type, void *data)
+{
+  upload *u;
+  reactor_http_server_session *session;
+  char *content;
+
+  u = state;
+  session = data;
+  if (type == REACTOR_HTTP_SERVER_ERROR)
+    u->errors ++;
+  if (type != REACTOR_HTTP_SERVER_REQUEST)
+    return;
+
+  u->requests ++;
+  u->spilled = session->request.content_fd >= 0;
+  assert_int_equal(session->request.content_size, u->size);
+  content = malloc(u->size);
+  assert_non_null(content);
+  if (u->spilled)
+    {
+      assert_int_equal(pread(session->request.content_fd, content, u->size, 0), u->size);
+      assert_memory_equal(content, u->body, u->size);
+    }
+  else
+    assert_memory_equal(session->request.content, u->body, u->size);
+  free(content);
+  reactor_http_server_session_respond(session, 200, "text/plain", "ok", 2);
+}
+
+/* feed a request with a body in small reads and report if it reached the handler through a file */
+static int upload_send(size_t spill, size_t size)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  upload u = {.size = size};
+  buffer input;
+  char header[256], output[4096];
+  size_t i, n;
+  ssize_t received;
+  int fd[2];
+
+  u.body = malloc(size);
+  assert_non_null(u.body);
+  for (i = 0; i < size; i ++)
+    u.body[i] = 'a' + i % 26;
+
+  reactor_core_construct();
+  reactor_http_server_init(&server, upload_event, &u);
+  reactor_http_server_spill(&server, spill);
+  reactor_http_server_date_update(&server);
+  session = session_connect(&server, fd);
+  buffer_init(&input);
+  n = snprintf(header, sizeof header, "POST /upload HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", size);
+  session_feed(session, &input, header, n);
+  for (i = 0; i < size; i += n)
+    {
+      n = size - i < 16384 ? size - i : 16384;
+      session_feed(session, &input, u.body + i, n);
+    }
+  assert_int_equal(buffer_size(&input), 0);
+  received = read(fd[1], output, sizeof output - 1);
+  assert_true(received > 0);
+  output[received] = '\0';
+  assert_true(strncmp(output, "HTTP/1.1 200 OK\r\n", 17) == 0);
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  buffer_clear(&input);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(u.errors, 0);
+  assert_int_equal(u.requests, 1);
+  free(u.body);
+  return u.spilled;
+}
+
+/* a body above the spill threshold reaches the handler in a file, one at or below it in memory */
+static void body_spill(void **state)
+{
+  (void) state;
+  assert_int_equal(upload_send(65536, 262144), 1);
+  assert_int_equal(upload_send(65536, 65536), 0);
+  assert_int_equal(upload_send(0, 262144), 0);
+}
+
+typedef struct expectation expectation;
+struct expectation
+{
+  unsigned               status;
+  size_t                 expects;
+  size_t                 requests;
+  size_t                 errors;
+};
+
+static void expectation_event(void *state, int type, void *data)
+{
+  expectation *e;
+
+  e = state;
+  switch (type)
+    {
+    case REACTOR_HTTP_SERVER_ERROR:
+      e->errors ++;
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST_EXPECT:
+      e->expects ++;
+      assert_int_equal(reactor_http_server_session_expect(data, e->status), 0);
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST:
+      e->requests ++;
+      assert_memory_equal(((reactor_http_server_session *) data)->request.content, "hello", 5);
+      reactor_http_server_session_respond(data, 200, "text/plain", "ok", 2);
+      break;
+    }
+}
+
+/* the interim response reaches the client before it sends the body, and a refusal ends the connection instead */
+static void expect_continue(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  expectation e = {.status = 100};
+  buffer input;
+  char output[4096], *header = "POST / HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 5\r\n\r\n";
+  ssize_t n;
+  int fd[2];
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_server_init(&server, expectation_event, &e);
+  reactor_http_server_date_update(&server);
+  buffer_init(&input);
+
+  session = session_connect(&server, fd);
+  session_feed(session, &input, header, strlen(header));
+  n = read(fd[1], output, sizeof output - 1);
+  assert_int_equal(n, 25);
+  assert_memory_equal(output, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+  assert_int_equal(e.requests, 0);
+  session_feed(session, &input, "hello", 5);
+  n = read(fd[1], output, sizeof output - 1);
+  assert_true(n > 0);
+  output[n] = '\0';
+  assert_true(strncmp(output, "HTTP/1.1 200 OK\r\n", 17) == 0);
+  assert_int_equal(e.expects, 1);
+  assert_int_equal(e.requests, 1);
+  assert_int_equal(buffer_size(&input), 0);
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+
+  e.status = 417;
+  session = session_connect(&server, fd);
+  session_feed(session, &input, header, strlen(header));
+  assert_int_equal(reactor_core_run(), 0);
+  n = read(fd[1], output, sizeof output - 1);
+  assert_true(n > 0);
+  output[n] = '\0';
+  assert_true(strncmp(output, "HTTP/1.1 417 ", 13) == 0);
+  assert_int_equal(read(fd[1], output, sizeof output), 0);
+  assert_int_equal(e.expects, 2);
+  assert_int_equal(e.requests, 1);
+  assert_int_equal(e.errors, 1);
+  (void) close(fd[1]);
+
+  buffer_clear(&input);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+}
+
+typedef struct streamed streamed;
+struct streamed
+{
+  size_t                 errors;
+  size_t                 headers;
+  size_t                 chunks;
+  size_t                 ends;
+  size_t                 requests;
+  buffer                 body;
+};
+
+static void streamed_event(void *state, int type, void *data)
+{
+  streamed *s;
+  reactor_http_server_session *session;
+  reactor_http_server_chunk *chunk;
+
+  s = state;
+  session = data;
+  switch (type)
+    {
+    case REACTOR_HTTP_SERVER_ERROR:
+      s->errors ++;
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST_HEADER:
+      s->headers ++;
+      if (strcmp(session->request.path, "/upload") == 0)
+        reactor_http_server_session_stream(session);
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST_CHUNK:
+      chunk = data;
+      s->chunks ++;
+      assert_int_equal(buffer_insert(&s->body, buffer_size(&s->body), chunk->base, chunk->size), 0);
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST_END:
+      s->ends ++;
+      reactor_http_server_session_respond(session, 200, "text/plain", "ok", 2);
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST:
+      s->requests ++;
+      reactor_http_server_session_respond(session, 200, "text/plain", "ok", 2);
+      break;
+    }
+}
+
+/* an opted in request body is handed over as it arrives and never accumulates in the input */
+static void request_stream(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  streamed s = {0};
+  buffer input;
+  char body[100000], output[4096], *request;
+  size_t i, n;
+  ssize_t received;
+  int fd[2];
+
+  (void) state;
+  for (i = 0; i < sizeof body; i ++)
+    body[i] = 'a' + i % 26;
+  buffer_init(&s.body);
+  buffer_init(&input);
+  reactor_core_construct();
+  reactor_http_server_init(&server, streamed_event, &s);
+  reactor_http_server_flags(&server, REACTOR_HTTP_SERVER_FLAGS_STREAM);
+  reactor_http_server_date_update(&server);
+  session = session_connect(&server, fd);
+
+  request = "POST /upload HTTP/1.1\r\nContent-Length: 100000\r\n\r\n";
+  session_feed(session, &input, request, strlen(request));
+  assert_int_equal(s.headers, 1);
+  for (i = 0; i < sizeof body; i += n)
+    {
+      n = sizeof body - i < 7000 ? sizeof body - i : 7000;
+      session_feed(session, &input, body + i, n);
+      assert_int_equal(buffer_size(&input), 0);
+    }
+  assert_true(s.chunks > 1);
+  assert_int_equal(s.ends, 1);
+  assert_int_equal(buffer_size(&s.body), sizeof body);
+  assert_memory_equal(buffer_data(&s.body), body, sizeof body);
+
+  /* chunked framing is removed before the handler sees the data */
+  buffer_erase(&s.body, 0, buffer_size(&s.body));
+  request = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n";
+  for (i = 0; i < strlen(request); i += n)
+    {
+      n = strlen(request) - i < 3 ? strlen(request) - i : 3;
+      session_feed(session, &input, request + i, n);
+    }
+  assert_int_equal(s.ends, 2);
+  assert_int_equal(buffer_size(&s.body), 11);
+  assert_memory_equal(buffer_data(&s.body), "hello world", 11);
+
+  /* requests not opted in are still delivered whole */
+  request = "POST /form HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+  session_feed(session, &input, request, strlen(request));
+  assert_int_equal(s.headers, 3);
+  assert_int_equal(s.requests, 1);
+  assert_int_equal(s.ends, 2);
+  assert_int_equal(buffer_size(&s.body), 11);
+
+  received = read(fd[1], output, sizeof output - 1);
+  assert_true(received > 0);
+  output[received] = '\0';
+  for (n = 0, request = output; (request = strstr(request, "HTTP/1.1 200 OK\r\n")); request ++)
+    n ++;
+  assert_int_equal(n, 3);
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  buffer_clear(&input);
+  buffer_clear(&s.body);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(s.errors, 0);
+}
+
+/* tick the wheel until the session's current timeout is due, it must not fire a second early */
+static void session_expire(reactor_http_server *server, reactor_http_server_session *session, int timeout, unsigned seconds)
+{
+  unsigned i;
+
+  assert_int_equal(session->timeout, timeout);
+  for (i = 1; i < seconds; i ++)
+    {
+      reactor_http_server_wheel_tick(server);
+      assert_int_equal(session->stream.state, REACTOR_STREAM_OPEN);
+      assert_int_equal(session->timeout, timeout);
+    }
+  reactor_http_server_wheel_tick(server);
+}
+
+/* wait for the server to close its end of the connection */
+static void session_closed(int fd)
+{
+  char buffer[65536];
+  ssize_t n;
+
+  assert_int_equal(reactor_core_run(), 0);
+  do
+    n = read(fd, buffer, sizeof buffer);
+  while (n > 0);
+  assert_int_equal(n, 0);
+  (void) close(fd);
+}
+
+/* every timeout fires at its own deadline, including an idle timeout beyond the last lap of the wheel */
+static void session_timeouts(void **state)
+{
+  reactor_http_server server;
+  reactor_http_server_session *session;
+  transfer t = {.body = "ok", .size = 2};
+  buffer input;
+  char *request;
+  int fd[2];
+
+  (void) state;
+  reactor_core_construct();
+  reactor_http_server_init(&server, transfer_event, &t);
+  reactor_http_server_timeouts(&server, 3, 5, 5000, 7);
+  reactor_http_server_reclaim(&server, 2);
+  reactor_http_server_date_update(&server);
+  buffer_init(&input);
+
+  session = session_connect(&server, fd);
+  request = "GET / HTTP/1.1\r\nHost";
+  session_feed(session, &input, request, strlen(request));
+  session_expire(&server, session, REACTOR_HTTP_SERVER_TIMEOUT_HEADER, 3);
+  session_closed(fd[1]);
+  buffer_erase(&input, 0, buffer_size(&input));
+
+  session = session_connect(&server, fd);
+  request = "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc";
+  session_feed(session, &input, request, strlen(request));
+  session_expire(&server, session, REACTOR_HTTP_SERVER_TIMEOUT_BODY, 5);
+  session_closed(fd[1]);
+  buffer_erase(&input, 0, buffer_size(&input));
+
+  /* an idle session first gives back its buffers and is closed once the rest of the idle timeout has passed */
+  session = session_connect(&server, fd);
+  request = "GET / HTTP/1.1\r\n\r\n";
+  session_feed(session, &input, request, strlen(request));
+  assert_int_equal(buffer_size(&input), 0);
+  session_expire(&server, session, REACTOR_HTTP_SERVER_TIMEOUT_RECLAIM, 2);
+  assert_int_equal(session->stream.state, REACTOR_STREAM_OPEN);
+  assert_int_equal(buffer_capacity(&session->stream.output), 0);
+  assert_true(session->wheel_slot >= server.wheel.laps && session->wheel_slot < server.wheel.laps + REACTOR_HTTP_SERVER_WHEEL_SIZE);
+  session_expire(&server, session, REACTOR_HTTP_SERVER_TIMEOUT_IDLE, 4998);
+  session_closed(fd[1]);
+
+  /* a peer that stops reading is cut off while the response is still queued */
+  t.size = 1048576;
+  t.body = calloc(1, t.size);
+  assert_non_null(t.body);
+  session = session_connect(&server, fd);
+  request = "GET / HTTP/1.1\r\n\r\n";
+  session_feed(session, &input, request, strlen(request));
+  assert_int_equal(t.released, 1);
+  session_expire(&server, session, REACTOR_HTTP_SERVER_TIMEOUT_WRITE, 7);
+  session_closed(fd[1]);
+  assert_int_equal(t.released, 2);
+  free(t.body);
+
+  buffer_clear(&input);
+  reactor_http_server_pool_clear(&server.pool);
+  reactor_http_server_buffers_clear(&server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(t.errors, 0);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(respond_no_allocation),
+    cmocka_unit_test(respond_overflow_no_allocation),
+    cmocka_unit_test(respond_prefix),
+    cmocka_unit_test(pipeline_versions),
+    cmocka_unit_test(pipeline_corked),
+    cmocka_unit_test(reclaim_buffers),
+    cmocka_unit_test(reference_partial_write),
+    cmocka_unit_test(stream_drain),
+    cmocka_unit_test(body_spill),
+    cmocka_unit_test(expect_continue),
+    cmocka_unit_test(request_stream),
+    cmocka_unit_test(session_timeouts)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
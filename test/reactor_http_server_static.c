@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+typedef struct files files;
+struct files
+{
+  reactor_http_server         server;
+  reactor_http_server_static  s;
+  size_t                      errors;
+  char                        base[64];
+  char                        root[80];
+};
+
+static void files_event(void *state, int type, void *data)
+{
+  files *f;
+  reactor_http_server_session *session;
+
+  f = state;
+  session = data;
+  if (type == REACTOR_HTTP_SERVER_ERROR)
+    f->errors ++;
+  if (type == REACTOR_HTTP_SERVER_REQUEST &&
+      reactor_http_server_static_respond(&f->s, session, &session->request) == -1)
+    reactor_http_server_session_respond(session, 404, NULL, NULL, 0);
+}
+
+static void files_write(files *f, char *name, char *content)
+{
+  char path[256];
+  FILE *file;
+
+  (void) snprintf(path, sizeof path, "%s/%s", f->base, name);
+  file = fopen(path, "w");
+  assert_non_null(file);
+  assert_int_equal(fputs(content, file) >= 0, 1);
+  assert_int_equal(fclose(file), 0);
+}
+
+/* base/secret.txt lies outside base/root, which holds index.html, sub/a.txt and symbolic links out of it */
+static void files_open(files *f)
+{
+  char path[256];
+
+  *f = (files) {0};
+  strcpy(f->base, "/tmp/reactor_http_static_XXXXXX");
+  assert_non_null(mkdtemp(f->base));
+  (void) snprintf(f->root, sizeof f->root, "%s/root", f->base);
+  assert_int_equal(mkdir(f->root, 0700), 0);
+  (void) snprintf(path, sizeof path, "%s/sub", f->root);
+  assert_int_equal(mkdir(path, 0700), 0);
+  files_write(f, "secret.txt", "secret");
+  files_write(f, "root/index.html", "hello");
+  files_write(f, "root/sub/a.txt", "a");
+  (void) snprintf(path, sizeof path, "%s/link.txt", f->root);
+  assert_int_equal(symlink("../secret.txt", path), 0);
+  (void) snprintf(path, sizeof path, "%s/up", f->root);
+  assert_int_equal(symlink("..", path), 0);
+
+  reactor_core_construct();
+  reactor_http_server_init(&f->server, files_event, f);
+  reactor_http_server_date_update(&f->server);
+  reactor_http_server_static_init(&f->s);
+  assert_int_equal(reactor_http_server_static_open(&f->s, "", f->root, 0), 0);
+}
+
+static void files_close(files *f)
+{
+  char command[256];
+
+  reactor_http_server_static_close(&f->s);
+  reactor_http_server_pool_clear(&f->server.pool);
+  reactor_http_server_buffers_clear(&f->server.buffers);
+  reactor_core_destruct();
+  assert_int_equal(f->errors, 0);
+  (void) snprintf(command, sizeof command, "rm -rf %s", f->base);
+  assert_int_equal(system(command), 0);
+}
+
+/* send one request and return the status of the response, with the whole response in output */
+static unsigned files_get(files *f, char *request, char *output, size_t size)
+{
+  reactor_http_server_session *session;
+  reactor_stream_data data;
+  char input[1024];
+  ssize_t n;
+  int fd[2];
+
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fd), 0);
+  session = reactor_http_server_pool_get(&f->server);
+  assert_non_null(session);
+  assert_int_equal(reactor_http_server_session_open(session, fd[0]), 0);
+
+  assert_true(strlen(request) < sizeof input);
+  strcpy(input, request);
+  data = (reactor_stream_data) {.base = input, .size = strlen(input)};
+  reactor_http_server_session_stream_event(session, REACTOR_STREAM_DATA, &data);
+  n = read(fd[1], output, size - 1);
+  assert_true(n > 0);
+  output[n] = '\0';
+
+  reactor_http_server_session_close(session);
+  assert_int_equal(reactor_core_run(), 0);
+  (void) close(fd[1]);
+  assert_memory_equal(output, "HTTP/1.1 ", 9);
+  return strtoul(output + 9, NULL, 10);
+}
+
+static void static_paths(void **state)
+{
+  files f;
+  char output[4096];
+
+  (void) state;
+  files_open(&f);
+  assert_int_equal(files_get(&f, "GET / HTTP/1.1\r\n\r\n", output, sizeof output), 200);
+  assert_non_null(strstr(output, "Content-Length: 5\r\n"));
+  assert_non_null(strstr(output, "\r\n\r\nhello"));
+  assert_int_equal(files_get(&f, "GET /sub/a.txt?x=1 HTTP/1.1\r\n\r\n", output, sizeof output), 200);
+  assert_non_null(strstr(output, "\r\n\r\na"));
+  assert_int_equal(files_get(&f, "GET /sub/%61.txt HTTP/1.1\r\n\r\n", output, sizeof output), 200);
+  assert_int_equal(files_get(&f, "HEAD /index.html HTTP/1.1\r\n\r\n", output, sizeof output), 200);
+  assert_non_null(strstr(output, "Content-Length: 5\r\n"));
+  assert_null(strstr(output, "hello"));
+  assert_int_equal(files_get(&f, "POST / HTTP/1.1\r\nContent-Length: 0\r\n\r\n", output, sizeof output), 405);
+  assert_non_null(strstr(output, "Allow: GET, HEAD\r\n"));
+  assert_int_equal(files_get(&f, "GET /missing HTTP/1.1\r\n\r\n", output, sizeof output), 404);
+  files_close(&f);
+}
+
+/* nothing outside the directory is served, however the path is spelled */
+static void static_escape(void **state)
+{
+  char *requests[] = {
+    "GET /../secret.txt HTTP/1.1\r\n\r\n",
+    "GET /sub/../../secret.txt HTTP/1.1\r\n\r\n",
+    "GET /%2e%2e/secret.txt HTTP/1.1\r\n\r\n",
+    "GET /sub/%2E%2E/%2e%2e/secret.txt HTTP/1.1\r\n\r\n",
+    "GET /%2e%2e%2fsecret.txt HTTP/1.1\r\n\r\n",
+    "GET /index.html%00 HTTP/1.1\r\n\r\n",
+    "GET /link.txt HTTP/1.1\r\n\r\n",
+    "GET /up/secret.txt HTTP/1.1\r\n\r\n",
+    "GET /up/root/index.html HTTP/1.1\r\n\r\n"
+  };
+  files f;
+  char output[4096];
+  size_t i;
+
+  (void) state;
+  files_open(&f);
+  for (i = 0; i < sizeof requests / sizeof requests[0]; i ++)
+    {
+      assert_int_equal(files_get(&f, requests[i], output, sizeof output), 404);
+      assert_null(strstr(output, "secret"));
+    }
+  files_close(&f);
+}
+
+/* a matching If-Modified-Since is answered with a 304 without a body or Content-Length */
+static void static_not_modified(void **state)
+{
+  files f;
+  char output[4096], request[256], modified[REACTOR_HTTP_DATE_SIZE], *p;
+
+  (void) state;
+  files_open(&f);
+  assert_int_equal(files_get(&f, "GET /index.html HTTP/1.1\r\n\r\n", output, sizeof output), 200);
+  p = strstr(output, "Last-Modified: ");
+  assert_non_null(p);
+  p += strlen("Last-Modified: ");
+  assert_true(strcspn(p, "\r") < sizeof modified);
+  memcpy(modified, p, strcspn(p, "\r"));
+  modified[strcspn(p, "\r")] = '\0';
+
+  (void) snprintf(request, sizeof request, "GET /index.html HTTP/1.1\r\nIf-Modified-Since: %s\r\n\r\n", modified);
+  assert_int_equal(files_get(&f, request, output, sizeof output), 304);
+  assert_null(strstr(output, "Content-Length"));
+  assert_int_equal(strlen(strstr(output, "\r\n\r\n")), 4);
+
+  (void) snprintf(request, sizeof request, "GET /index.html HTTP/1.1\r\nIf-Modified-Since: %s\r\n\r\n",
+                  "Thu, 01 Jan 1970 00:00:00 GMT");
+  assert_int_equal(files_get(&f, request, output, sizeof output), 200);
+  assert_non_null(strstr(output, "\r\n\r\nhello"));
+  files_close(&f);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(static_paths),
+    cmocka_unit_test(static_escape),
+    cmocka_unit_test(static_not_modified)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+#include <netdb.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cmocka.h>
+
+#include <dynamic.h>
+#include <reactor_core.h>
+#include <reactor_net.h>
+
+#include "reactor_http.h"
+
+typedef struct farm farm;
+struct farm
+{
+  reactor_http_server_workers workers;
+  pthread_t              thread;
+  char                   service[16];
+  size_t                 count;
+  int                    flags;
+  int                    result;
+  pthread_mutex_t        mutex;
+  size_t                 starts;
+  size_t                 requests;
+  size_t                 served;
+};
+
+static void farm_event(void *state, int type, void *data)
+{
+  farm *f;
+  reactor_http_server_session *session;
+  reactor_http_server_worker *worker;
+
+  f = state;
+  switch (type)
+    {
+    case REACTOR_HTTP_SERVER_START:
+      (void) pthread_mutex_lock(&f->mutex);
+      f->starts ++;
+      (void) pthread_mutex_unlock(&f->mutex);
+      break;
+    case REACTOR_HTTP_SERVER_REQUEST:
+      session = data;
+      worker = (reactor_http_server_worker *) ((char *) session->server - offsetof(reactor_http_server_worker, server));
+      (void) pthread_mutex_lock(&f->mutex);
+      f->requests ++;
+      f->served = worker->index;
+      (void) pthread_mutex_unlock(&f->mutex);
+      reactor_http_server_session_respond(session, 200, "text/plain", "ok", 2);
+      break;
+    }
+}
+
+static void *farm_thread(void *arg)
+{
+  farm *f;
+
+  f = arg;
+  f->result = reactor_http_server_workers_run(&f->workers, f->count, f->flags, farm_event, f, "127.0.0.1", f->service);
+  return NULL;
+}
+
+/* a port that was free a moment ago */
+static void farm_service(farm *f)
+{
+  struct sockaddr_in sin = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  socklen_t len = sizeof sin;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  assert_true(fd >= 0);
+  assert_int_equal(bind(fd, (struct sockaddr *) &sin, sizeof sin), 0);
+  assert_int_equal(getsockname(fd, (struct sockaddr *) &sin, &len), 0);
+  (void) close(fd);
+  (void) snprintf(f->service, sizeof f->service, "%u", ntohs(sin.sin_port));
+}
+
+static void farm_start(farm *f, size_t count, int flags)
+{
+  size_t starts;
+
+  *f = (farm) {.count = count, .flags = flags};
+  (void) pthread_mutex_init(&f->mutex, NULL);
+  farm_service(f);
+  assert_int_equal(pthread_create(&f->thread, NULL, farm_thread, f), 0);
+
+  /* a worker that has started means reactor_http_server_workers_run() is in progress and may be stopped */
+  do
+    {
+      (void) pthread_mutex_lock(&f->mutex);
+      starts = f->starts;
+      (void) pthread_mutex_unlock(&f->mutex);
+      if (!starts)
+        (void) usleep(1000);
+    }
+  while (!starts);
+}
+
+static void farm_stop(farm *f)
+{
+  reactor_http_server_workers_stop(&f->workers);
+  assert_int_equal(pthread_join(f->thread, NULL), 0);
+  (void) pthread_mutex_destroy(&f->mutex);
+  assert_int_equal(f->result, 0);
+}
+
+/* connect and send a request, retrying while the listeners are still being opened, returns the status line */
+static int farm_get(farm *f, char *output, size_t size)
+{
+  struct sockaddr_in sin = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+  char *request = "GET / HTTP/1.1\r\nConnection: close\r\n\r\n";
+  size_t received, attempts;
+  ssize_t n;
+  int fd, e;
+
+  sin.sin_port = htons(atoi(f->service));
+  for (attempts = 0; attempts < 1000; attempts ++)
+    {
+      fd = socket(AF_INET, SOCK_STREAM, 0);
+      assert_true(fd >= 0);
+      e = connect(fd, (struct sockaddr *) &sin, sizeof sin);
+      if (e == 0)
+        break;
+      (void) close(fd);
+      (void) usleep(1000);
+    }
+  if (e == -1)
+    return -1;
+
+  assert_int_equal(write(fd, request, strlen(request)), strlen(request));
+  for (received = 0; received < size - 1; received += n)
+    {
+      n = read(fd, output + received, size - 1 - received);
+      if (n <= 0)
+        break;
+    }
+  output[received] = '\0';
+  (void) close(fd);
+  return 0;
+}
+
+/* all workers serve requests on one port, and stopping them closes every listener and joins every thread */
+static void workers_start_stop(void **state)
+{
+  farm f;
+  char output[1024];
+  size_t i;
+
+  (void) state;
+  farm_start(&f, 4, 0);
+  for (i = 0; i < 16; i ++)
+    {
+      assert_int_equal(farm_get(&f, output, sizeof output), 0);
+      assert_true(strncmp(output, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    }
+  farm_stop(&f);
+  assert_int_equal(f.starts, 4);
+  assert_int_equal(f.requests, 16);
+}
+
+/* a stop that arrives while workers are still waiting for their turn to open ends all of them */
+static void workers_stop_early(void **state)
+{
+  farm f;
+
+  (void) state;
+  farm_start(&f, 8, 0);
+  farm_stop(&f);
+  assert_int_equal(f.requests, 0);
+}
+
+/* with the filter attached, a connection made from cpu n lands on worker (n % count), which only holds when the
+ * listeners joined the group in worker order */
+static void workers_cbpf(void **state)
+{
+  farm f;
+  cpu_set_t set, saved;
+  char output[1024];
+  long cpus, cpu;
+  size_t served;
+
+  (void) state;
+  assert_int_equal(pthread_getaffinity_np(pthread_self(), sizeof saved, &saved), 0);
+  cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  farm_start(&f, 3, REACTOR_HTTP_SERVER_WORKERS_CBPF);
+  for (cpu = 0; cpu < cpus && cpu < 8; cpu ++)
+    {
+      if (!CPU_ISSET(cpu, &saved))
+        continue;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0)
+        continue;
+      assert_int_equal(farm_get(&f, output, sizeof output), 0);
+      assert_true(strncmp(output, "HTTP/1.1 200 OK\r\n", 17) == 0);
+      (void) pthread_mutex_lock(&f.mutex);
+      served = f.served;
+      (void) pthread_mutex_unlock(&f.mutex);
+      assert_int_equal(served, cpu % 3);
+    }
+  (void) pthread_setaffinity_np(pthread_self(), sizeof saved, &saved);
+  farm_stop(&f);
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(workers_start_stop),
+    cmocka_unit_test(workers_stop_early),
+    cmocka_unit_test(workers_cbpf)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
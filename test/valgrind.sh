@@ -1,7 +1,7 @@
 #!/bin/sh
 
 if command -v valgrind; then
-    for file in reactor_core reactor_user reactor_desc reactor_timer reactor_signal reactor_stream
+    for file in picohttpparser reactor_http reactor_http_client reactor_http_parser reactor_http_server reactor_http_server_static reactor_http_server_workers reactor_http_resolver
     do
         echo [$file]
         if ! valgrind --error-exitcode=1 --track-fds=yes \